@@ -0,0 +1,533 @@
+#include "algorithmauction.h"
+#include "paletteindex.h"
+
+#include <QImage>
+#include <QHash>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+// Relative to the mean distance of a pixel to its nearest palette color.
+static const double kFinalEpsilon = 1e-3;
+
+struct AuctionBid
+{
+	int iObject;
+	double fPrice;
+	int iPerson;
+	int iAmount;
+};
+
+AlgorithmAuctionBase::AlgorithmAuctionBase()
+	: mInput()
+	, mPalette()
+	, vInputGroups()
+	, vPaletteGroups()
+	, vInputColors()
+	, vPaletteColors()
+	, mInputPoints()
+	, mPalettePoints()
+	, mPaletteTree()
+	, iBits(8)
+	, vPersons()
+	, vObjects()
+	, fEpsilon(0)
+	, fFinalEpsilon(0)
+	, fMinPrice(0)
+	, iExact(0)
+	, iGreedy(0)
+	, fTotalCost(0)
+{
+}
+
+void AlgorithmAuctionBase::assign(Pixel color, const int *indices, int n)
+{
+	setResults(indices, n, color.c, 0);
+}
+
+QVector<AlgorithmAuctionBase::Group> AlgorithmAuctionBase::createGroups(const ColorHistogram &hist, int bits)
+{
+	unsigned int high = (0xff << (8 - bits)) & 0xff;
+	unsigned int mask = 0xff000000 | (high << 16) | (high << 8) | high;
+
+	QVector<Group> groups;
+	QVector<double> sums;
+	QHash<unsigned int, int> lookup;
+
+	for (int c = 0; c < hist.size(); c++)
+	{
+		auto n = hist.remaining(c);
+		if (n == 0)
+			continue;
+
+		auto color = hist.color(c);
+		auto it = lookup.find(color.c & mask);
+		if (it == lookup.end())
+		{
+			it = lookup.insert(color.c & mask, groups.size());
+
+			Group g;
+			g.mColor = color;
+			g.iCount = 0;
+			g.iCursor = 0;
+			groups.append(g);
+			sums.append(0);
+			sums.append(0);
+			sums.append(0);
+		}
+
+		auto &g = groups[*it];
+		g.vColors.append(c);
+		g.iCount += n;
+		sums[*it * 3 + 0] += double(color.r) * n;
+		sums[*it * 3 + 1] += double(color.g) * n;
+		sums[*it * 3 + 2] += double(color.b) * n;
+	}
+
+	for (int i = 0; i < groups.size(); i++)
+	{
+		auto &g = groups[i];
+		g.mColor.r = (unsigned char)(sums[i * 3 + 0] / g.iCount + 0.5);
+		g.mColor.g = (unsigned char)(sums[i * 3 + 1] / g.iCount + 0.5);
+		g.mColor.b = (unsigned char)(sums[i * 3 + 2] / g.iCount + 0.5);
+	}
+
+	return groups;
+}
+
+void AlgorithmAuctionBase::takePixels(ColorHistogram &hist, Group &group, int n, QVector<int> &indices, QVector<Pixel> &colors)
+{
+	indices.clear();
+	colors.clear();
+
+	while (n > 0 && group.iCursor < group.vColors.size())
+	{
+		auto c = group.vColors[group.iCursor];
+		const int *taken = nullptr;
+		auto m = hist.take(c, n, &taken);
+		if (m == 0)
+		{
+			group.iCursor++;
+			continue;
+		}
+
+		for (int i = 0; i < m; i++)
+		{
+			indices.append(taken[i]);
+			colors.append(hist.color(c));
+		}
+
+		n -= m;
+	}
+}
+
+void AlgorithmAuctionBase::listCandidates(int person, int count)
+{
+	auto &p = vPersons[person];
+
+	QVector<int> nearest;
+	mPaletteTree.nearest(mInputPoints.at(person), count, nearest);
+	Counters::count(Counters::kCounterDistances, nearest.size());
+
+	p.vCandidates.clear();
+	p.vCosts.clear();
+	p.fFarthest = 0;
+
+	for (auto j : nearest)
+	{
+		// the hue of a grey is undefined, it fits any hue
+		auto d = cost(person, j);
+		if (d != d)
+			d = 0;
+
+		p.vCandidates.append(j);
+		p.vCosts.append(d);
+		p.fFarthest = std::max(p.fFarthest, d);
+	}
+}
+
+bool AlgorithmAuctionBase::setup(QImage *input, QImage *palette)
+{
+	if (!IAlgorithm::setup(input, palette))
+		return false;
+
+	{
+		CounterScope scope(mCounters, Counters::kPhaseSort);
+		mInput.build(pInput);
+
+		auto index = paletteIndex();
+		if (index)
+			index->histogram(mPalette);
+		else
+			mPalette.build(pCurrent);
+	}
+
+	iExact = matchExactColors(mInput, mPalette, [this](Pixel color, const int *indices, int n)
+	{
+		assign(color, indices, n);
+	});
+
+	// the coarsest grouping either image needs
+	for (iBits = 8; iBits > 1; iBits--)
+	{
+		vInputGroups = createGroups(mInput, iBits);
+		vPaletteGroups = createGroups(mPalette, iBits);
+		if (vInputGroups.size() <= kMaxGroups && vPaletteGroups.size() <= kMaxGroups)
+			break;
+	}
+
+	vInputColors.clear();
+	for (auto &g : vInputGroups)
+		vInputColors.append(g.mColor);
+
+	vPaletteColors.clear();
+	for (auto &g : vPaletteGroups)
+		vPaletteColors.append(g.mColor);
+
+	mInputPoints.build(vInputColors, pointSpace());
+	mPalettePoints.build(vPaletteColors, pointSpace());
+
+	vObjects.clear();
+	QVector<int> capacity;
+	for (auto &g : vPaletteGroups)
+	{
+		Object o;
+		o.iCapacity = g.iCount;
+		o.iHeld = 0;
+		o.fFloor = 0;
+		vObjects.append(o);
+		capacity.append(g.iCount);
+	}
+
+	mPaletteTree.build(mPalettePoints, capacity);
+
+	vPersons.clear();
+	for (auto &g : vInputGroups)
+	{
+		Person p;
+		p.iDemand = g.iCount;
+		p.iLeft = p.iDemand;
+		p.iBidObject = -1;
+		p.fBidPrice = 0;
+		p.fFarthest = 0;
+		vPersons.append(p);
+	}
+
+	QVector<int> all;
+	for (int i = 0; i < vPersons.size(); i++)
+		all.append(i);
+
+	QtConcurrent::blockingMap(all, [this](int &i)
+	{
+		CounterScope scope(vPersons[i].mCounts);
+		listCandidates(i, kCandidates);
+	});
+
+	mergeCounts(all);
+
+	vOfferOf.fill(-1, vPersons.size());
+
+	// the scale of the problem is how far colors are from their nearest match,
+	// by cost, which under HSV is not the order of the tree (hue, saturation
+	// and value)
+	double scale = 0;
+	for (auto &p : vPersons)
+	{
+		if (!p.vCosts.isEmpty())
+			scale += *std::min_element(p.vCosts.begin(), p.vCosts.end()) * p.iDemand;
+	}
+
+	scale /= std::max(1, iCount - iExact);
+	scale = std::max(scale, 1e-9);
+	fEpsilon = scale / kEpsilonScale;
+	fFinalEpsilon = scale * kFinalEpsilon;
+	iGreedy = 0;
+	fTotalCost = 0;
+
+	return true;
+}
+
+double AlgorithmAuctionBase::priceFor(const Object &o, int person) const
+{
+	if (o.iHeld < o.iCapacity)
+		return o.fFloor;
+
+	for (int i = o.vHeld.size() - 1; i >= 0; i--)
+	{
+		if (o.vHeld[i].iPerson != person)
+			return o.vHeld[i].fPrice;
+	}
+
+	// all of it is ours already
+	return std::numeric_limits<double>::max();
+}
+
+void AlgorithmAuctionBase::bid(int person)
+{
+	auto &p = vPersons[person];
+	auto lowest = -std::numeric_limits<double>::max();
+
+	for (;;)
+	{
+		auto best = -1;
+		auto v1 = lowest;
+		auto v2 = lowest;
+
+		for (int i = 0; i < p.vCandidates.size(); i++)
+		{
+			auto v = -p.vCosts[i] - priceFor(vObjects[p.vCandidates[i]], person);
+			if (v > v1)
+			{
+				v2 = v1;
+				v1 = v;
+				best = p.vCandidates[i];
+			}
+			else if (v > v2)
+			{
+				v2 = v;
+			}
+		}
+
+		// A group outside of the list costs at least about fFarthest and at
+		// least fMinPrice to get. The list grows until that cannot beat the
+		// best or the second best one, which sets how much the bid can raise.
+		auto outside = -p.fFarthest - fMinPrice;
+		if (p.vCandidates.size() < vObjects.size() && (best < 0 || outside > v2))
+		{
+			listCandidates(person, std::min(p.vCandidates.size() * 2, vObjects.size()));
+			continue;
+		}
+
+		if (v2 == lowest)
+			v2 = v1 - p.fFarthest - fEpsilon;
+
+		p.iBidObject = best;
+		p.fBidPrice = priceFor(vObjects[best], person) + (v1 - v2) + fEpsilon;
+		return;
+	}
+}
+
+void AlgorithmAuctionBase::resolve(const QVector<int> &active)
+{
+	QVector<AuctionBid> bids;
+	bids.reserve(active.size());
+	for (auto i : active)
+	{
+		auto &p = vPersons[i];
+		bids.append({p.iBidObject, p.fBidPrice, i, p.iLeft});
+		p.iLeft = 0;
+	}
+
+	std::sort(bids.begin(), bids.end(), [](const AuctionBid &a, const AuctionBid &b)
+	{
+		return a.iObject < b.iObject || (a.iObject == b.iObject && a.fPrice > b.fPrice);
+	});
+
+	// Every object keeps the highest of its held blocks and new bids up to its
+	// capacity, what does not fit goes back to the persons that lose it. A
+	// bidder that already holds part of the object moves it to the new price,
+	// so it never competes with itself.
+	QVector<Block> offered;
+	QVector<Block> kept;
+	QVector<Block> merged;
+	for (int first = 0; first < bids.size();)
+	{
+		auto &o = vObjects[bids[first].iObject];
+
+		offered.clear();
+		auto last = first;
+		for (; last < bids.size() && bids[last].iObject == bids[first].iObject; last++)
+		{
+			vOfferOf[bids[last].iPerson] = offered.size();
+			offered.append({bids[last].iPerson, bids[last].iAmount, bids[last].fPrice});
+		}
+
+		kept.clear();
+		for (auto &b : o.vHeld)
+		{
+			auto offer = vOfferOf[b.iPerson];
+			if (offer >= 0)
+				offered[offer].iAmount += b.iAmount;
+			else
+				kept.append(b);
+		}
+
+		for (auto &b : offered)
+			vOfferOf[b.iPerson] = -1;
+
+		std::swap(o.vHeld, kept);
+
+		merged.resize(o.vHeld.size() + offered.size());
+		std::merge(o.vHeld.begin(), o.vHeld.end(), offered.begin(), offered.end(), merged.begin(), [](const Block &a, const Block &b)
+		{
+			return a.fPrice > b.fPrice;
+		});
+
+		o.vHeld.clear();
+		o.iHeld = 0;
+		for (auto &b : merged)
+		{
+			auto take = std::min(b.iAmount, o.iCapacity - o.iHeld);
+			if (take > 0)
+			{
+				o.vHeld.append({b.iPerson, take, b.fPrice});
+				o.iHeld += take;
+			}
+
+			vPersons[b.iPerson].iLeft += b.iAmount - take;
+		}
+
+		first = last;
+	}
+}
+
+void AlgorithmAuctionBase::runPhase()
+{
+	// Prices carry over from the last phase, assignments start over. A common
+	// shift of all prices changes nothing, so the lowest one is brought to 0.
+	auto lowest = std::numeric_limits<double>::max();
+	for (auto &o : vObjects)
+	{
+		o.fFloor = price(o);
+		lowest = std::min(lowest, o.fFloor);
+	}
+
+	for (auto &o : vObjects)
+	{
+		o.fFloor -= lowest;
+		o.vHeld.clear();
+		o.iHeld = 0;
+	}
+
+	for (auto &p : vPersons)
+		p.iLeft = p.iDemand;
+
+	QVector<int> active;
+	for (int round = 0; round < kMaxRounds; round++)
+	{
+		active.clear();
+		for (int i = 0; i < vPersons.size(); i++)
+		{
+			if (vPersons[i].iLeft > 0)
+				active.append(i);
+		}
+
+		if (active.isEmpty())
+			return;
+
+		fMinPrice = std::numeric_limits<double>::max();
+		for (auto &o : vObjects)
+			fMinPrice = std::min(fMinPrice, price(o));
+
+		QtConcurrent::blockingMap(active, [this](int &i)
+		{
+			CounterScope scope(vPersons[i].mCounts);
+			bid(i);
+		});
+
+		mergeCounts(active);
+
+		resolve(active);
+	}
+}
+
+void AlgorithmAuctionBase::mergeCounts(const QVector<int> &persons)
+{
+	Counters::Values sum;
+	for (auto i : persons)
+	{
+		sum.merge(vPersons[i].mCounts);
+		vPersons[i].mCounts = Counters::Values();
+	}
+
+	mCounters.merge(sum);
+}
+
+void AlgorithmAuctionBase::place(int person, int object, int n)
+{
+	QVector<int> indices;
+	QVector<int> unused;
+	QVector<Pixel> colors;
+	QVector<Pixel> paletteColors;
+
+	takePixels(mInput, vInputGroups[person], n, indices, colors);
+	takePixels(mPalette, vPaletteGroups[object], n, unused, paletteColors);
+
+	// at 8 bits every group is a single color, already converted
+	auto exact = iBits == 8;
+	auto d = exact ? cost(person, object) : 0;
+	ErrorTracker::Changes changes;
+	for (int i = 0; i < indices.size(); i++)
+	{
+		if (exact)
+			setResult(indices[i], paletteColors[i].c, d, changes);
+		else
+			setResult(indices[i], paletteColors[i].c, changes);
+	}
+
+	mError.apply(changes);
+}
+
+void AlgorithmAuctionBase::writeResult()
+{
+	QVector<int> placed(vPersons.size());
+
+	fTotalCost = 0;
+	for (int j = 0; j < vObjects.size(); j++)
+	{
+		for (auto &b : vObjects[j].vHeld)
+		{
+			auto &p = vPersons[b.iPerson];
+			place(b.iPerson, j, b.iAmount);
+			placed[b.iPerson] += b.iAmount;
+
+			auto i = p.vCandidates.indexOf(j);
+			if (i >= 0)
+				fTotalCost += p.vCosts[i] * b.iAmount;
+		}
+	}
+
+	// the rounds ran out, what is left goes to the nearest group with room
+	QVector<int> room;
+	for (auto &o : vObjects)
+		room.append(o.iCapacity - o.iHeld);
+
+	ColorKdTree tree;
+	tree.build(mPalettePoints, room);
+
+	iGreedy = 0;
+	for (int i = 0; i < vPersons.size(); i++)
+	{
+		auto left = vPersons[i].iDemand - placed[i];
+		while (left > 0)
+		{
+			auto k = tree.nearest(mInputPoints.at(i));
+			auto n = tree.take(k, left);
+			place(i, k, n);
+			left -= n;
+			iGreedy += n;
+		}
+	}
+}
+
+bool AlgorithmAuctionBase::update()
+{
+	runPhase();
+
+	bFinished = (fEpsilon <= fFinalEpsilon);
+
+	if (bFinished)
+	{
+		writeResult();
+		emit finished(pCurrent);
+	}
+	else
+	{
+		fEpsilon = std::max(fEpsilon / kEpsilonScale, fFinalEpsilon);
+		emit step();
+	}
+
+	return bFinished;
+}
+
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmAuction)
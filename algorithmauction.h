@@ -0,0 +1,159 @@
+#ifndef ALGORITHMAUCTION_H
+#define ALGORITHMAUCTION_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include "colorhistogram.h"
+#include "colorkdtree.h"
+#include <QVector>
+
+// Input to palette assignment as a transport problem over distinct colors:
+// every input color sends its pixels to palette colors, every palette color
+// takes as many pixels as use it, and the total distance is minimized. Solved
+// with the auction algorithm for transportation problems (Bertsekas and
+// Castanon) with epsilon scaling: input colors bid for palette colors, which
+// keep the highest bids up to their capacity and raise their price until
+// every pixel is placed. Bids of a round are computed in parallel.
+//
+// Colors that are not exact matches are grouped by dropping low bits until
+// neither image has more than kMaxGroups groups, so noisy photos stay
+// tractable, and the auction runs between groups. Groups start bidding on the
+// kCandidates palette groups nearest in 3-D to keep the problem sparse, and
+// double their list whenever a group outside of it could be worth more than
+// the best ones in it. With complete lists the total distance between groups
+// would be within pixels * final epsilon of the optimum, the 3-D cut makes
+// that approximate for non euclidean distances. Pixels still unplaced after
+// kMaxRounds go to the nearest group with room left.
+class AlgorithmAuctionBase : public IAlgorithm
+{
+	public:
+		AlgorithmAuctionBase();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+
+		// One epsilon phase per update, the last one writes the result.
+		virtual bool update() override;
+
+		static const int kMaxGroups = 4096;
+		static const int kCandidates = 16;
+		static const int kEpsilonScale = 4;
+		static const int kMaxRounds = 20000;	// per phase
+
+	protected:
+		// Space the candidates are searched in.
+		virtual ColorSpace pointSpace() const = 0;
+
+		// Distance between an input and a palette group.
+		virtual double cost(int input, int palette) const = 0;
+
+		// Colors sharing their high bits, with pixels left.
+		struct Group
+		{
+			Pixel mColor;			// mean color
+			int iCount;
+			int iCursor;			// into vColors, while pixels are handed out
+			QVector<int> vColors;	// histogram colors
+		};
+
+		static QVector<Group> createGroups(const ColorHistogram &hist, int bits);
+		void takePixels(ColorHistogram &hist, Group &group, int n, QVector<int> &indices, QVector<Pixel> &colors);
+
+		struct Block
+		{
+			int iPerson;
+			int iAmount;
+			double fPrice;
+		};
+
+		// An input group, bidding for its pixels.
+		struct Person
+		{
+			int iDemand;
+			int iLeft;
+			int iBidObject;
+			double fBidPrice;
+			double fFarthest;			// largest cost in the list
+			QVector<int> vCandidates;	// object indices
+			QVector<double> vCosts;
+			Counters::Values mCounts;	// while bidding on a worker thread
+		};
+
+		// A palette group, holding the best bids up to its capacity.
+		struct Object
+		{
+			int iCapacity;
+			int iHeld;
+			double fFloor;		// price of units nobody holds
+			QVector<Block> vHeld;	// by descending price
+		};
+
+		double price(const Object &o) const
+		{
+			return o.iHeld < o.iCapacity ? o.fFloor : o.vHeld.last().fPrice;
+		}
+
+		// What a person has to outbid, its own blocks do not count.
+		double priceFor(const Object &o, int person) const;
+
+		// Only touch vPersons[person], so persons can run in parallel.
+		void listCandidates(int person, int count);
+		void bid(int person);
+		void resolve(const QVector<int> &active);
+		void mergeCounts(const QVector<int> &persons);
+		void runPhase();
+		void writeResult();
+		void place(int person, int object, int n);
+		void assign(Pixel color, const int *indices, int n);
+
+		ColorHistogram mInput;
+		ColorHistogram mPalette;
+
+		// Persons and objects, same indices.
+		QVector<Group> vInputGroups;
+		QVector<Group> vPaletteGroups;
+		QVector<Pixel> vInputColors;	// mean color of each group
+		QVector<Pixel> vPaletteColors;
+		ColorCache mInputPoints;
+		ColorCache mPalettePoints;
+		ColorKdTree mPaletteTree;		// for candidate lists
+
+		int iBits;						// bits per channel kept by the groups
+
+		QVector<Person> vPersons;
+		QVector<Object> vObjects;
+		QVector<int> vOfferOf;			// scratch for resolve, per person
+
+		double fEpsilon;
+		double fFinalEpsilon;
+		double fMinPrice;				// lowest object price this round
+
+		int iExact;				// pixels that kept their own color
+		int iGreedy;			// pixels placed outside of the auction
+		double fTotalCost;
+};
+
+template <class Metric>
+class AlgorithmAuction : public AlgorithmAuctionBase
+{
+	public:
+		virtual QString name() override
+		{
+			return "Auction Transport";
+		}
+
+	protected:
+		virtual ColorSpace pointSpace() const override
+		{
+			return Metric::kSpace;
+		}
+
+		virtual double cost(int input, int palette) const override
+		{
+			return Metric::distance(Metric::color(vInputColors[input], mInputPoints, input),
+									Metric::color(vPaletteColors[palette], mPalettePoints, palette));
+		}
+};
+
+DECLARE_METRIC_TEMPLATES(AlgorithmAuction)
+
+#endif // ALGORITHMAUCTION_H
@@ -1,17 +1,19 @@
-#include "algorithmcopy.h"
-#include <QImage>
-
-bool AlgorithmCopy::setup(QImage *input, QImage *, DistanceFunction)
-{
-	delete pCurrent;
-	pCurrent = new QImage(*input);
-
-	emit finished(pCurrent);
-
-	return true;
-}
-
-bool AlgorithmCopy::update()
-{
-	return bFinished = true;
-}
+#include "algorithmcopy.h"
+#include <QImage>
+
+bool AlgorithmCopy::setup(QImage *input, QImage *)
+{
+	iCancelled.storeRelease(0);
+
+	delete pCurrent;
+	pCurrent = new QImage(*input);
+
+	emit finished(pCurrent);
+
+	return true;
+}
+
+bool AlgorithmCopy::update()
+{
+	return bFinished = true;
+}
@@ -0,0 +1,149 @@
+#include "algorithmhistogram.h"
+#include "paletteindex.h"
+
+#include <QImage>
+#include <algorithm>
+
+AlgorithmHistogramBase::AlgorithmHistogramBase()
+	: mInput()
+	, mPalette()
+	, mPaletteKeys()
+	, vPaletteColor()
+	, vInputColor()
+	, vInputKeys()
+	, iCurPos(0)
+	, iExact(0)
+{
+}
+
+void AlgorithmHistogramBase::assign(Pixel color, const int *indices, int n)
+{
+	setResults(indices, n, color.c);
+}
+
+// Colors of a histogram with pixels left, sorted by key.
+static void sortedColors(const ColorHistogram &hist, ColorKeysFunction computeKeys, QVector<int> &order, QVector<double> &keys)
+{
+	QVector<Pixel> colors;
+	QVector<int> left;
+	for (int i = 0; i < hist.size(); i++)
+	{
+		if (hist.remaining(i) == 0)
+			continue;
+
+		colors.append(hist.color(i));
+		left.append(i);
+	}
+
+	QVector<double> colorKey(colors.size());
+	computeKeys(colors, colorKey.data());
+
+	QVector<int> sorted(colors.size());
+	for (int i = 0; i < sorted.size(); i++)
+		sorted[i] = i;
+
+	std::stable_sort(sorted.begin(), sorted.end(), [&colorKey](int a, int b)
+	{
+		return colorKey[a] < colorKey[b];
+	});
+
+	order.resize(sorted.size());
+	keys.resize(sorted.size());
+	for (int i = 0; i < sorted.size(); i++)
+	{
+		order[i] = left[sorted[i]];
+		keys[i] = colorKey[sorted[i]];
+	}
+}
+
+// Same from the keys and order of a palette index, hist holding its colors.
+static void indexedColors(const ColorHistogram &hist, const PaletteIndex *index, QVector<int> &order, QVector<double> &keys)
+{
+	order.clear();
+	keys.clear();
+
+	auto sorted = index->colorOrder();
+	auto colorKey = index->colorKeys();
+	for (int i = 0; i < hist.size(); i++)
+	{
+		auto c = sorted[i];
+		if (hist.remaining(c) == 0)
+			continue;
+
+		order.append(c);
+		keys.append(colorKey[c]);
+	}
+}
+
+bool AlgorithmHistogramBase::setup(QImage *input, QImage *palette)
+{
+	if (!IAlgorithm::setup(input, palette))
+		return false;
+
+	auto index = paletteIndex();
+	{
+		CounterScope scope(mCounters, Counters::kPhaseSort);
+		mInput.build(pInput);
+
+		if (index)
+			index->histogram(mPalette);
+		else
+			mPalette.build(pCurrent);
+	}
+
+	iExact = matchExactColors(mInput, mPalette, [this](Pixel color, const int *indices, int n)
+	{
+		assign(color, indices, n);
+	});
+
+	auto keys = keyFunction();
+	QVector<double> paletteKeys;
+	{
+		CounterScope scope(mCounters, Counters::kPhaseSort);
+		sortedColors(mInput, keys, vInputColor, vInputKeys);
+
+		if (index)
+			indexedColors(mPalette, index, vPaletteColor, paletteKeys);
+		else
+			sortedColors(mPalette, keys, vPaletteColor, paletteKeys);
+	}
+
+	QVector<int> counts(vPaletteColor.size());
+	for (int i = 0; i < counts.size(); i++)
+		counts[i] = mPalette.remaining(vPaletteColor[i]);
+
+	mPaletteKeys.reset(paletteKeys, counts);
+	iCurPos = 0;
+
+	return true;
+}
+
+bool AlgorithmHistogramBase::update()
+{
+	auto budget = kUpdateSize;
+	while (budget > 0 && iCurPos < vInputColor.size())
+	{
+		auto c = vInputColor[iCurPos];
+		auto k = mPaletteKeys.findBisect(vInputKeys[iCurPos]);
+		auto n = mPaletteKeys.take(k, std::min(mInput.remaining(c), budget));
+
+		const int *indices = nullptr;
+		mInput.take(c, n, &indices);
+		assign(mPalette.color(vPaletteColor[k]), indices, n);
+		budget -= n;
+
+		if (mInput.remaining(c) == 0)
+			iCurPos++;
+	}
+
+	bFinished = (iCurPos == vInputColor.size());
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmHistogramBisect)
@@ -0,0 +1,56 @@
+#ifndef ALGORITHMHISTOGRAM_H
+#define ALGORITHMHISTOGRAM_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include "colorhistogram.h"
+#include "consumablekeys.h"
+#include <QVector>
+
+// Bisect over distinct colors instead of pixels. Pixels whose color is also in
+// the palette keep it, then the input colors left are walked by ascending key
+// and take palette colors by bisect, as many pixels at once as both have left.
+class AlgorithmHistogramBase : public IAlgorithm
+{
+	public:
+		AlgorithmHistogramBase();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+
+	protected:
+		// Sort keys of a list of colors, see colorKeys.
+		virtual ColorKeysFunction keyFunction() const = 0;
+
+		void assign(Pixel color, const int *indices, int n);
+
+		ColorHistogram mInput;
+		ColorHistogram mPalette;
+		ConsumableKeys mPaletteKeys;	// palette colors left, by key
+		QVector<int> vPaletteColor;		// histogram color of each mPaletteKeys entry
+		QVector<int> vInputColor;		// input colors left, by key
+		QVector<double> vInputKeys;
+
+		int iCurPos;
+		int iExact;						// pixels that kept their own color
+};
+
+template <class Metric>
+class AlgorithmHistogramBisect : public AlgorithmHistogramBase
+{
+	public:
+		virtual QString name() override
+		{
+			return "Histogram Bisect";
+		}
+
+	protected:
+		virtual ColorKeysFunction keyFunction() const override
+		{
+			return colorKeys<Metric>;
+		}
+};
+
+DECLARE_METRIC_TEMPLATES(AlgorithmHistogramBisect)
+
+#endif // ALGORITHMHISTOGRAM_H
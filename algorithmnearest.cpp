@@ -0,0 +1,192 @@
+#include "algorithmnearest.h"
+#include "paletteindex.h"
+
+#include <QImage>
+#include <QtConcurrent/QtConcurrent>
+
+// Units in [0, end) that round robin deals to partition p of count.
+static int dealt(int end, int p, int count)
+{
+	return (end + count - 1 - p) / count;
+}
+
+AlgorithmNearestBase::AlgorithmNearestBase(int partitions)
+	: mInput()
+	, mPalette()
+	, mInputPoints()
+	, mPalettePoints()
+	, mTree()
+	, vPartitions()
+	, iPartitions(std::max(1, partitions))
+	, iCurPartition(0)
+	, iExact(0)
+{
+}
+
+bool AlgorithmNearestBase::setup(QImage *input, QImage *palette)
+{
+	if (!IAlgorithm::setup(input, palette))
+		return false;
+
+	{
+		CounterScope scope(mCounters, Counters::kPhaseSort);
+		mInput.build(pInput);
+
+		auto index = paletteIndex();
+		if (index)
+			index->histogram(mPalette);
+		else
+			mPalette.build(pCurrent);
+	}
+
+	iExact = matchExactColors(mInput, mPalette, [this](Pixel color, const int *indices, int n)
+	{
+		setResults(indices, n, color.c, 0);
+	});
+
+	mInputPoints.build(mInput.colors(), pointSpace());
+
+	mPalettePoints.build(mPalette.colors(), pointSpace());
+
+	QVector<int> counts(mPalette.size());
+	for (int c = 0; c < mPalette.size(); c++)
+		counts[c] = mPalette.remaining(c);
+
+	mTree.build(mPalettePoints, counts);
+
+	vPartitions.clear();
+	vPartitions.resize(iPartitions);
+
+	// input pixels, each partition gets a slice of the pixels of every color
+	for (int c = 0, unit = 0; c < mInput.size(); c++)
+	{
+		const int *indices = nullptr;
+		auto n = mInput.take(c, mInput.remaining(c), &indices);
+
+		for (int p = 0; p < iPartitions; p++)
+		{
+			InputRun run;
+			run.iColor = c;
+			run.iLeft = dealt(unit + n, p, iPartitions) - dealt(unit, p, iPartitions);
+			run.pIndices = indices;
+			indices += run.iLeft;
+
+			if (run.iLeft > 0)
+				vPartitions[p].vInput.append(run);
+		}
+
+		unit += n;
+	}
+
+	iCurPartition = 0;
+
+	return true;
+}
+
+int AlgorithmNearestBase::run(int partition, int budget)
+{
+	auto &part = vPartitions[partition];
+
+	// partitions run on worker threads in the threaded technique
+	ErrorTracker::Changes changes;
+	int done = 0;
+	while (done < budget && part.iCurPos < part.vInput.size())
+	{
+		auto &run = part.vInput[part.iCurPos];
+		auto k = mTree.nearest(mInputPoints.at(run.iColor));
+		auto n = mTree.take(k, std::min(run.iLeft, budget - done));
+		if (n == 0)
+			continue;		// another partition took the last units of k
+
+		setResults(run.pIndices, n, mPalette.color(k).c, cost(run.iColor, k), changes);
+		run.pIndices += n;
+		run.iLeft -= n;
+		done += n;
+
+		if (run.iLeft == 0)
+			part.iCurPos++;
+	}
+
+	mError.apply(changes);
+
+	return done;
+}
+
+bool AlgorithmNearestBase::update()
+{
+	auto budget = kUpdateSize;
+	while (budget > 0 && iCurPartition < vPartitions.size())
+	{
+		budget -= run(iCurPartition, budget);
+
+		auto &part = vPartitions[iCurPartition];
+		if (part.iCurPos == part.vInput.size())
+			iCurPartition++;
+	}
+
+	bFinished = (iCurPartition == vPartitions.size());
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+AlgorithmNearestThreadedBase::AlgorithmNearestThreadedBase()
+	: AlgorithmNearestBase(QThread::idealThreadCount())
+	, mThreadWorker()
+{
+}
+
+AlgorithmNearestThreadedBase::~AlgorithmNearestThreadedBase()
+{
+	// workers write into pCurrent, which the base destructor frees
+	for (auto &worker : mThreadWorker)
+		worker.waitForFinished();
+}
+
+void AlgorithmNearestThreadedBase::doWork(int id)
+{
+	CounterScope scope(mCounters, Counters::kPhaseMatch);
+
+	// slices of an update, so a cancel is seen soon
+	while (!isCancelled() && run(id, kUpdateSize) > 0)
+		;
+}
+
+bool AlgorithmNearestThreadedBase::setup(QImage *input, QImage *palette)
+{
+	for (auto &worker : mThreadWorker)
+		worker.waitForFinished();
+
+	mThreadWorker.clear();
+
+	if (!AlgorithmNearestBase::setup(input, palette))
+		return false;
+
+	for (int i = 0; i < iPartitions; i++)
+		mThreadWorker.append(QtConcurrent::run(this, &AlgorithmNearestThreadedBase::doWork, i));
+
+	return true;
+}
+
+bool AlgorithmNearestThreadedBase::update()
+{
+	// update() runs off the GUI thread, waiting beats polling in a loop
+	for (auto &worker : mThreadWorker)
+		worker.waitForFinished();
+
+	bFinished = !isCancelled();
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmNearestColor)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmNearestColorThreaded)
@@ -0,0 +1,132 @@
+#ifndef ALGORITHMNEAREST_H
+#define ALGORITHMNEAREST_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include "colorhistogram.h"
+#include "colorkdtree.h"
+#include <QVector>
+#include <QFuture>
+
+// Every input color takes the nearest palette color left, searched in 3-D
+// (the color space of the metric) with a k-d tree instead of comparing one
+// scalar key. Works on distinct colors like Histogram Bisect: pixels whose
+// color is in the palette keep it, the rest is matched a run at a time.
+//
+// The input pixels left are split in partitions by dealing their units round
+// robin, so every partition gets a slice of every color. The serial technique
+// has one partition, the threaded one a partition per thread. All of them take
+// from one tree, so every pixel still gets the nearest color left, only which
+// partition gets there first changes from run to run.
+//
+// A tree per partition with a share of the palette units kept the threaded
+// results repeatable, but the nearest color was often used up in its share
+// while left in others: on 512x512 random noise the total error grew by 60%
+// (CIEDE2000) to 200% (RGB) with 4 partitions and kept growing with more. The
+// shared tree stays within 3% of the serial technique up to 32 threads.
+class AlgorithmNearestBase : public IAlgorithm
+{
+	public:
+		AlgorithmNearestBase(int partitions = 1);
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+
+	protected:
+		// Space the tree and the queries work in.
+		virtual ColorSpace pointSpace() const = 0;
+
+		// Distance between an input and a palette histogram color.
+		virtual double cost(int input, int palette) const = 0;
+
+		// Matches up to budget pixels of a partition, returns how many.
+		int run(int partition, int budget);
+
+		struct InputRun
+		{
+			int iColor;
+			int iLeft;
+			const int *pIndices;
+		};
+
+		struct Partition
+		{
+			QVector<InputRun> vInput;
+			int iCurPos;
+		};
+
+		ColorHistogram mInput;
+		ColorHistogram mPalette;
+		ColorCache mInputPoints;	// per input histogram color
+		ColorCache mPalettePoints;	// per palette histogram color
+		ColorKdTree mTree;			// palette units left, shared by the partitions
+		QVector<Partition> vPartitions;
+
+		int iPartitions;
+		int iCurPartition;
+		int iExact;					// pixels that kept their own color
+};
+
+class AlgorithmNearestThreadedBase : public AlgorithmNearestBase
+{
+	public:
+		AlgorithmNearestThreadedBase();
+		virtual ~AlgorithmNearestThreadedBase();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+
+	protected:
+		void doWork(int id);
+
+		QVector<QFuture<void>> mThreadWorker;
+};
+
+template <class Metric>
+class AlgorithmNearestColor : public AlgorithmNearestBase
+{
+	public:
+		virtual QString name() override
+		{
+			return "Nearest Color";
+		}
+
+	protected:
+		virtual ColorSpace pointSpace() const override
+		{
+			return Metric::kSpace;
+		}
+
+		virtual double cost(int input, int palette) const override
+		{
+			return Metric::distance(Metric::color(mInput.color(input), mInputPoints, input),
+									Metric::color(mPalette.color(palette), mPalettePoints, palette));
+		}
+};
+
+template <class Metric>
+class AlgorithmNearestColorThreaded : public AlgorithmNearestThreadedBase
+{
+	public:
+		virtual QString name() override
+		{
+			return "Threaded Nearest Color";
+		}
+
+	protected:
+		virtual ColorSpace pointSpace() const override
+		{
+			return Metric::kSpace;
+		}
+
+		virtual double cost(int input, int palette) const override
+		{
+			return Metric::distance(Metric::color(mInput.color(input), mInputPoints, input),
+									Metric::color(mPalette.color(palette), mPalettePoints, palette));
+		}
+};
+
+DECLARE_METRIC_TEMPLATES(AlgorithmNearestColor)
+DECLARE_METRIC_TEMPLATES(AlgorithmNearestColorThreaded)
+
+#endif // ALGORITHMNEAREST_H
@@ -0,0 +1,174 @@
+#include "algorithmregistry.h"
+#include "algorithmcopy.h"
+#include "algorithmsort.h"
+#include "algorithmswap.h"
+#include "algorithmhistogram.h"
+#include "algorithmnearest.h"
+#include "algorithmauction.h"
+#include "metric.h"
+
+typedef IAlgorithm *(*AlgorithmFactory)();
+
+struct TechniqueEntry
+{
+	QString sName;
+	QList<AlgorithmFactory> vFactories; // one per distance
+};
+
+// Every technique measures its result with the distance it was created for,
+// see IAlgorithm::error.
+template <class T, class Metric>
+static IAlgorithm *create()
+{
+	auto algo = new T;
+	algo->setErrorDistance(pixelDistance<Metric>);
+	return algo;
+}
+
+static QString nameOf(AlgorithmFactory factory)
+{
+	auto algo = factory();
+	auto name = algo->name();
+	delete algo;
+	return name;
+}
+
+// Same order as RTP_FOR_EACH_METRIC.
+template <template <class> class T>
+static TechniqueEntry technique()
+{
+	TechniqueEntry e;
+	e.vFactories.append(create<T<RtmDistance>, RtmDistance>);
+	e.vFactories.append(create<T<ColorMetric>, ColorMetric>);
+	e.vFactories.append(create<T<CieDe2000>, CieDe2000>);
+	e.vFactories.append(create<T<Cie1976>, Cie1976>);
+	e.vFactories.append(create<T<HueDistance>, HueDistance>);
+	e.vFactories.append(create<T<RtmDistanceFloat>, RtmDistanceFloat>);
+	e.vFactories.append(create<T<CieDe2000Float>, CieDe2000Float>);
+	e.vFactories.append(create<T<Cie1976Float>, Cie1976Float>);
+	e.vFactories.append(create<T<HueDistanceFloat>, HueDistanceFloat>);
+	e.sName = nameOf(e.vFactories.first());
+	return e;
+}
+
+// Techniques that do not use a distance, still measured with each one.
+template <class T>
+static TechniqueEntry technique()
+{
+	TechniqueEntry e;
+	e.vFactories.append(create<T, RtmDistance>);
+	e.vFactories.append(create<T, ColorMetric>);
+	e.vFactories.append(create<T, CieDe2000>);
+	e.vFactories.append(create<T, Cie1976>);
+	e.vFactories.append(create<T, HueDistance>);
+	e.vFactories.append(create<T, RtmDistanceFloat>);
+	e.vFactories.append(create<T, CieDe2000Float>);
+	e.vFactories.append(create<T, Cie1976Float>);
+	e.vFactories.append(create<T, HueDistanceFloat>);
+	e.sName = nameOf(e.vFactories.first());
+	return e;
+}
+
+static QList<TechniqueEntry> createTechniques()
+{
+	QList<TechniqueEntry> list;
+
+	list.append(technique<AlgorithmBisectDistanceThreaded>());
+	list.append(technique<AlgorithmSwapDistance>());
+	list.append(technique<AlgorithmSwapDistanceThreaded>());
+	list.append(technique<AlgorithmSwapPyramid>());
+	list.append(technique<AlgorithmIndexedReplace>());
+	list.append(technique<AlgorithmBisectDistance>());
+	list.append(technique<AlgorithmBisectDistanceQt>());
+	list.append(technique<AlgorithmHistogramBisect>());
+	list.append(technique<AlgorithmNearestColor>());
+	list.append(technique<AlgorithmNearestColorThreaded>());
+	list.append(technique<AlgorithmAuction>());
+	list.append(technique<AlgorithmCopy>());
+
+	return list;
+}
+
+static const QList<TechniqueEntry> &techniques()
+{
+	static const QList<TechniqueEntry> list = createTechniques();
+	return list;
+}
+
+QStringList distanceList()
+{
+	QStringList list;
+
+	list.append(RtmDistance::name());
+	list.append(ColorMetric::name());
+	list.append(CieDe2000::name());
+	list.append(Cie1976::name());
+	list.append(HueDistance::name());
+	list.append(RtmDistanceFloat::name());
+	list.append(CieDe2000Float::name());
+	list.append(Cie1976Float::name());
+	list.append(HueDistanceFloat::name());
+
+	return list;
+}
+
+QStringList techniqueList()
+{
+	QStringList list;
+	for (auto t : techniques())
+		list.append(t.sName);
+
+	return list;
+}
+
+IAlgorithm *createAlgorithm(int technique, int distance)
+{
+	auto &list = techniques();
+	if (technique < 0 || technique >= list.size())
+		return nullptr;
+
+	auto &factories = list.at(technique).vFactories;
+	if (distance < 0 || distance >= factories.size())
+		return nullptr;
+
+	return factories.at(distance)();
+}
+
+// Same order as distanceList().
+ColorKeysFunction keyFunction(int distance)
+{
+	static const ColorKeysFunction list[] =
+	{
+		colorKeys<RtmDistance>,
+		colorKeys<ColorMetric>,
+		colorKeys<CieDe2000>,
+		colorKeys<Cie1976>,
+		colorKeys<HueDistance>,
+		colorKeys<RtmDistanceFloat>,
+		colorKeys<CieDe2000Float>,
+		colorKeys<Cie1976Float>,
+		colorKeys<HueDistanceFloat>
+	};
+
+	auto count = int(sizeof(list) / sizeof(list[0]));
+	return (distance >= 0 && distance < count) ? list[distance] : nullptr;
+}
+
+ErrorTracker::Distance distanceFunction(int distance)
+{
+	static const ErrorTracker::Distance list[] =
+	{
+		pixelDistance<RtmDistance>,
+		pixelDistance<ColorMetric>,
+		pixelDistance<CieDe2000>,
+		pixelDistance<Cie1976>,
+		pixelDistance<HueDistance>,
+		pixelDistance<RtmDistanceFloat>,
+		pixelDistance<CieDe2000Float>,
+		pixelDistance<Cie1976Float>,
+		pixelDistance<HueDistanceFloat>
+	};
+
+	auto count = int(sizeof(list) / sizeof(list[0]));
+	return (distance >= 0 && distance < count) ? list[distance] : nullptr;
+}
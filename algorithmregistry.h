@@ -0,0 +1,27 @@
+#ifndef ALGORITHMREGISTRY_H
+#define ALGORITHMREGISTRY_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include <QStringList>
+
+// Techniques are instantiated once per distance (see metric.h), so the GUI
+// and the CLI pick a technique and a distance by index and get the matching
+// specialization.
+
+// Distance names, in display order.
+QStringList distanceList();
+
+// Technique names, in display order.
+QStringList techniqueList();
+
+// A fresh instance of a technique specialized for a distance, or nullptr for
+// an out of range index. Caller owns it.
+IAlgorithm *createAlgorithm(int technique, int distance);
+
+// Sort keys and pixel distance of a distance, for code that runs without a
+// technique instance, like the tiled mode. nullptr for an out of range index.
+ColorKeysFunction keyFunction(int distance);
+ErrorTracker::Distance distanceFunction(int distance);
+
+#endif // ALGORITHMREGISTRY_H
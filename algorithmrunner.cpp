@@ -0,0 +1,125 @@
+#include "algorithmrunner.h"
+#include "ialgorithm.h"
+#include <QtConcurrent/QtConcurrent>
+
+AlgorithmRunner::Run::Run()
+	: pAlgorithm(nullptr)
+	, mInput()
+	, mPalette()
+	, mWorker()
+	, iCancelled(0)
+	, iRun(0)
+{
+}
+
+AlgorithmRunner::AlgorithmRunner(QObject *parent)
+	: QObject(parent)
+	, pCurrent(nullptr)
+	, vRetired()
+	, iSteps(0)
+	, iRun(0)
+{
+	connect(this, SIGNAL(workDone(int)), this, SLOT(onWorkDone(int)), Qt::QueuedConnection);
+}
+
+AlgorithmRunner::~AlgorithmRunner()
+{
+	cancel();
+
+	// the only place that waits, the workers use the techniques
+	for (auto run : vRetired)
+	{
+		run->mWorker.waitForFinished();
+		delete run->pAlgorithm;
+		delete run;
+	}
+}
+
+void AlgorithmRunner::start(IAlgorithm *algorithm, const QImage &input, const QImage &palette, int maxSteps)
+{
+	cancel();
+
+	pCurrent = new Run;
+	pCurrent->pAlgorithm = algorithm;
+	pCurrent->mInput = input;
+	pCurrent->mPalette = palette;
+	pCurrent->iRun = ++iRun;
+
+	iSteps.store(0);
+	pCurrent->mWorker = QtConcurrent::run(this, &AlgorithmRunner::work, pCurrent, maxSteps);
+}
+
+void AlgorithmRunner::cancel()
+{
+	if (!pCurrent)
+		return;
+
+	pCurrent->iCancelled.storeRelease(1);
+	pCurrent->pAlgorithm->cancel();
+
+	vRetired.append(pCurrent);
+	pCurrent = nullptr;
+
+	// a worker that already returned has its workDone() queued, or handled
+	onWorkDone(-1);
+}
+
+bool AlgorithmRunner::isRunning() const
+{
+	return pCurrent && !pCurrent->mWorker.isFinished();
+}
+
+IAlgorithm *AlgorithmRunner::algorithm() const
+{
+	return pCurrent ? pCurrent->pAlgorithm : nullptr;
+}
+
+void AlgorithmRunner::onWorkDone(int run)
+{
+	// the worker of run has returned, its future finishes right after
+	for (int i = vRetired.size() - 1; i >= 0; i--)
+	{
+		auto retired = vRetired.at(i);
+		if (retired->iRun == run)
+			retired->mWorker.waitForFinished();
+		else if (!retired->mWorker.isFinished())
+			continue;
+
+		vRetired.removeAt(i);
+		delete retired->pAlgorithm;
+		delete retired;
+	}
+}
+
+void AlgorithmRunner::work(Run *run, int maxSteps)
+{
+	auto algorithm = run->pAlgorithm;
+
+	bool ready;
+	{
+		CounterScope scope(algorithm->counters(), Counters::kPhaseSetup);
+		ready = algorithm->setup(&run->mInput, &run->mPalette);
+	}
+
+	// a cancel that came before setup() got cleared by it
+	if (run->iCancelled.loadAcquire())
+		algorithm->cancel();
+
+	if (ready)
+	{
+		emit started(run->iRun);
+
+		auto done = false;
+		while (!done && iSteps.load() < maxSteps && !run->iCancelled.loadAcquire())
+		{
+			done = algorithm->process();
+
+			// steps() belongs to the current run
+			if (!run->iCancelled.loadAcquire())
+				iSteps.ref();
+		}
+	}
+
+	emit finished(run->iRun, algorithm->isCancelled());
+	emit workDone(run->iRun);
+}
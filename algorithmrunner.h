@@ -0,0 +1,87 @@
+#ifndef ALGORITHMRUNNER_H
+#define ALGORITHMRUNNER_H
+
+#include <QObject>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QImage>
+#include <QList>
+
+class IAlgorithm;
+
+// Sets up a technique and runs its update slices back to back on a pool
+// thread, so neither a timer nor the GUI thread limits how fast it goes.
+//
+// While it runs, its owner polls steps(), the error and the dirty tiles of
+// the technique, which are all safe to read from another thread. started()
+// and finished() are queued to receivers living in other threads.
+//
+// cancel() never waits: the run is told to stop and set aside, and the
+// runner deletes its technique once the worker is done with it, which may
+// be after a setup that does not look at the cancel flag.
+class AlgorithmRunner : public QObject
+{
+	Q_OBJECT
+	public:
+		explicit AlgorithmRunner(QObject *parent = nullptr);
+		virtual ~AlgorithmRunner();
+
+		// Takes algorithm over, input and palette are copied (shared until
+		// written), so the caller may drop them at once.
+		void start(IAlgorithm *algorithm, const QImage &input, const QImage &palette, int maxSteps);
+
+		// Asks the current run to stop and forgets it, finished() still comes.
+		void cancel();
+
+		bool isRunning() const;
+
+		// Technique of the current run, nullptr once cancelled. Valid until
+		// the next start() or cancel().
+		IAlgorithm *algorithm() const;
+
+		// Update slices done so far.
+		int steps() const
+		{
+			return iSteps.load();
+		}
+
+		// Counts start() calls. Signals carry the run they belong to, since
+		// the queued ones of a cancelled run can arrive after the next start.
+		int run() const
+		{
+			return iRun;
+		}
+
+	signals:
+		// Setup succeeded, the result image exists from here on.
+		void started(int run);
+		void finished(int run, bool cancelled);
+
+		// The worker of a run returned, queued to the runner itself.
+		void workDone(int run);
+
+	private slots:
+		void onWorkDone(int run);
+
+	private:
+		struct Run
+		{
+			Run();
+
+			IAlgorithm *pAlgorithm;
+			QImage mInput;
+			QImage mPalette;
+			QFuture<void> mWorker;
+			QAtomicInt iCancelled;		// setup() resets the flag of the technique
+			int iRun;
+		};
+
+		void work(Run *run, int maxSteps);
+
+		Run *pCurrent;
+		QList<Run *> vRetired;			// cancelled, worker still busy
+		QAtomicInt iSteps;
+		int iRun;
+};
+
+#endif // ALGORITHMRUNNER_H
@@ -1,231 +1,285 @@
-#include "algorithmsort.h"
-
-#include <qalgorithms.h>
-#include <QImage>
-#include <QColor>
-#include <QtConcurrent/QtConcurrent>
-
-QList<PixelPos> createPixelList(const QImage *img, DistanceFunction func)
-{
-	auto h = img->height();
-	auto w = img->width();
-
-	QList<PixelPos> p;
-	p.reserve(h * w);
-
-	for (int i = 0, y = 0 ; y < h; y++)
-	{
-		for (int x = 0 ; x < w; x++, i++)
-		{
-			auto px = Pixel(img->pixel(x, y));
-			PixelPos e(px, x, y, func);
-			p.append(e);
-		}
-	}
-
-	qSort(p.begin(), p.end(), [](const PixelPos a, const PixelPos b)
-	{
-		return a.fD < b.fD;
-	});
-
-	return std::move(p);
-}
-
-
-PixelPos findNearest(QList<PixelPos> &list, double value)
-{
-	QList<PixelPos>::iterator it = qLowerBound(list.begin(), list.end(), value, [](const PixelPos px, const double d)
-	{
-		return px.fD < d;
-	});
-
-	auto ret = *it;
-	list.erase(it);
-	return ret;
-}
-
-PixelPos binarySearch(QList<PixelPos> &list, double value, int lower, int higher)
-{
-	if (lower == higher || higher < 0)
-	{
-		auto px = list[lower];
-		list.removeAt(lower);
-		return px;
-	}
-	else if (lower > higher)
-	{
-		PixelPos pl;
-		double vl = 0;
-
-		auto ph = list[lower];
-		double vh = ph.fD;
-
-		if (lower > 0)
-		{
-			pl = list[lower - 1];
-			vl = pl.fD;
-		}
-
-		double diffH = std::abs(value - vh);
-		double diffL = value - vl;
-
-		if (diffH < diffL)
-		{
-			list.removeAt(lower);
-			return ph;
-		}
-
-		list.removeAt(lower - 1);
-		return pl;
-	}
-
-	int mid = (higher + lower) >> 1;
-	auto p = list[mid];
-
-	if (p.fD > value)
-		return binarySearch(list, value, lower, mid - 1);
-	else if (p.fD < value)
-		return binarySearch(list, value, mid + 1, higher);
-	else
-	{
-		list.removeAt(mid);
-		return p;
-	}
-}
-
-AlgorithmSortBase::AlgorithmSortBase()
-	: vInput()
-	, vPalette()
-	, iCurPos(0)
-{
-}
-
-AlgorithmSortBase::~AlgorithmSortBase()
-{
-	vInput.clear();
-	vPalette.clear();
-}
-
-bool AlgorithmSortBase::setup(QImage *input, QImage *palette, DistanceFunction func)
-{
-	if (!IAlgorithm::setup(input, palette, func))
-		return false;
-
-	vInput = createPixelList(pInput, func);
-	vPalette = createPixelList(pPalette, func);
-	iCurPos = 0;
-
-	return true;
-}
-
-bool AlgorithmIndexedReplace::update()
-{
-	for (int i = 0; i < kUpdateSize && iCurPos < iCount; i++, iCurPos++)
-	{
-		auto ori = vInput.at(iCurPos);
-		auto pal = vPalette.at(iCurPos);
-		pCurrent->setPixel(ori.x, ori.y, pal.p.c);
-	}
-
-	bFinished = (iCurPos == iCount);
-
-	if (bFinished)
-		emit finished(pCurrent);
-	else
-		emit step();
-
-	return bFinished;
-}
-
-bool AlgorithmBisectDistance::update()
-{
-	for (int i = 0; i < 10 && iCurPos < iCount; i++, iCurPos++)
-	{
-		auto ori = vInput.at(iCurPos);
-		auto pal = binarySearch(vPalette, ori.fD, 0, vPalette.size() - 1);
-		pCurrent->setPixel(ori.x, ori.y, pal.p.c);
-	}
-
-	bFinished = (iCurPos == iCount);
-
-	if (bFinished)
-		emit finished(pCurrent);
-	else
-		emit step();
-
-	return bFinished;
-}
-
-bool AlgorithmBisectDistanceQt::update()
-{
-	for (int i = 0; i < 10 && iCurPos < iCount; i++, iCurPos++)
-	{
-		auto ori = vInput.at(iCurPos);
-		auto pal = findNearest(vPalette, ori.fD);
-		pCurrent->setPixel(ori.x, ori.y, pal.p.c);
-	}
-
-	bFinished = (iCurPos == iCount);
-
-	if (bFinished)
-		emit finished(pCurrent);
-	else
-		emit step();
-
-	return bFinished;
-}
-
-void AlgorithmBisectDistanceThreaded::doWork(QList<PixelPos> palette, int id)
-{
-//	auto myid = id;
-	auto len = palette.size();
-	auto start = id * len;
-	auto end = len - 1;
-	for (int i = 0; i < len; i++)
-	{
-		auto ori = vInput.at(start + i);
-		//auto pal = findNearest(palette, ori.fD);
-		auto pal = binarySearch(palette, ori.fD, 0, end--);
-		pCurrent->setPixel(ori.x, ori.y, pal.p.c);
-	}
-}
-
-bool AlgorithmBisectDistanceThreaded::setup(QImage *input, QImage *palette, DistanceFunction func)
-{
-	if (!AlgorithmSortBase::setup(input, palette, func))
-		return false;
-
-	auto px = pCurrent->pixel(0, 0);
-	pCurrent->setPixel(0, 0, px); // copy on write
-
-	iWorkers = QThread::idealThreadCount();
-	auto workerSize = iCount / iWorkers;
-
-	mThreadPalette.clear();
-	mThreadWorker.clear();
-	for (int i = 0; i < iWorkers; i++)
-		mThreadPalette.append(vPalette.mid(i * workerSize, workerSize));
-
-	for (int i = 0; i < iWorkers; i++)
-		mThreadWorker.append(QtConcurrent::run(this, &AlgorithmBisectDistanceThreaded::doWork, mThreadPalette[i], i));
-
-	return true;
-}
-
-bool AlgorithmBisectDistanceThreaded::update()
-{
-	int count = 0;
-	for (int i = 0; i < iWorkers; i++)
-	{
-		count += mThreadWorker[i].isFinished();
-	}
-
-	bFinished = (count == iWorkers);
-
-	if (bFinished)
-		emit finished(pCurrent);
-	else
-		emit step();
-
-	return bFinished;
-}
+#include "algorithmsort.h"
+#include "paletteindex.h"
+
+#include <algorithm>
+#include <QImage>
+#include <QColor>
+#include <QtConcurrent/QtConcurrent>
+
+QVector<double> AlgorithmSortBase::sortKeys(const QVector<SortedPixel> &list, int first, int count)
+{
+	QVector<double> keys(count);
+	for (int i = 0; i < count; i++)
+		keys[i] = list.at(first + i).fD;
+
+	return keys;
+}
+
+AlgorithmSortBase::LastPair::LastPair()
+	: iInput(0)
+	, iPalette(0)
+	, fDistance(0)
+	, bValid(false)
+{
+}
+
+AlgorithmSortBase::AlgorithmSortBase()
+	: vInput()
+	, vPalette()
+	, iCurPos(0)
+{
+}
+
+AlgorithmSortBase::~AlgorithmSortBase()
+{
+	vInput.clear();
+	vPalette.clear();
+}
+
+bool AlgorithmSortBase::setup(QImage *input, QImage *palette)
+{
+	if (!IAlgorithm::setup(input, palette))
+		return false;
+
+	auto index = paletteIndex();
+	vInput = createPixelList(pInput, kSortedIndex, keyFunction(), mCounters);
+	vPalette = index ? index->sortedPixels() : createPixelList(pCurrent, kSortedColor, keyFunction(), mCounters);
+	iCurPos = 0;
+
+	return true;
+}
+
+template <class Metric>
+bool AlgorithmIndexedReplace<Metric>::update()
+{
+	ErrorTracker::Changes changes;
+	LastPair last;
+	for (int i = 0; i < kUpdateSize && iCurPos < iCount; i++, iCurPos++)
+	{
+		auto ori = vInput.at(iCurPos);
+		auto pal = vPalette.at(iCurPos);
+		setSorted(ori.iIndex, pal.c, last, changes);
+	}
+
+	mError.apply(changes);
+
+	bFinished = (iCurPos == iCount);
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+bool AlgorithmBisectBase::setup(QImage *input, QImage *palette)
+{
+	if (!AlgorithmSortBase::setup(input, palette))
+		return false;
+
+	mPaletteKeys.reset(sortKeys(vPalette, 0, vPalette.size()));
+
+	return true;
+}
+
+template <class Metric>
+bool AlgorithmBisectDistance<Metric>::update()
+{
+	ErrorTracker::Changes changes;
+	LastPair last;
+	for (int i = 0; i < 10 && iCurPos < iCount; i++, iCurPos++)
+	{
+		auto ori = vInput.at(iCurPos);
+		auto pal = vPalette.at(mPaletteKeys.takeBisect(ori.fD));
+		setSorted(ori.iIndex, pal.c, last, changes);
+	}
+
+	mError.apply(changes);
+
+	bFinished = (iCurPos == iCount);
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+template <class Metric>
+bool AlgorithmBisectDistanceQt<Metric>::update()
+{
+	ErrorTracker::Changes changes;
+	LastPair last;
+	for (int i = 0; i < 10 && iCurPos < iCount; i++, iCurPos++)
+	{
+		auto ori = vInput.at(iCurPos);
+		auto pal = vPalette.at(mPaletteKeys.takeLowerBound(ori.fD));
+		setSorted(ori.iIndex, pal.c, last, changes);
+	}
+
+	mError.apply(changes);
+
+	bFinished = (iCurPos == iCount);
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+template <class Metric>
+void AlgorithmBisectDistanceThreaded<Metric>::match(Range &range)
+{
+	if (range.vInput.isEmpty() || range.vPalette.isEmpty())
+		return;
+
+	TraceScope trace("match", "worker");
+	trace.setArg("pixels", range.vInput.size());
+
+	QVector<double> values(range.vPalette.size());
+	for (int i = 0; i < values.size(); i++)
+		values[i] = vPalette.at(range.vPalette[i]).fD;
+
+	CounterScope scope(mCounters);
+	ConsumableKeys keys;
+	keys.reset(values);
+
+	ErrorTracker::Changes changes;
+	LastPair last;
+	int i = 0;
+	for (; i < range.vInput.size() && keys.remaining() && !isCancelled(); i++)
+	{
+		auto ori = vInput.at(range.vInput[i]);
+		auto pal = vPalette.at(range.vPalette[keys.takeBisect(ori.fD)]);
+		setSorted(ori.iIndex, pal.c, last, changes);
+	}
+
+	mError.apply(changes);
+
+	QVector<int> palette;
+	for (int j = 0; j < keys.size(); j++)
+	{
+		if (!keys.isTaken(j))
+			palette.append(range.vPalette[j]);
+	}
+
+	range.vInput = range.vInput.mid(i);
+	range.vPalette = palette;
+}
+
+template <class Metric>
+void AlgorithmBisectDistanceThreaded<Metric>::doWork()
+{
+	TraceScope trace("doWork", "worker");
+	CounterScope scope(mCounters, Counters::kPhaseMatch);
+
+	for (;;)
+	{
+		TraceScope pass("pass", "worker");
+		pass.setArg("ranges", vRanges.size());
+
+		QtConcurrent::blockingMap(vRanges, [this](Range &range)
+		{
+			match(range);
+		});
+
+		if (vRanges.size() <= 1 || isCancelled())
+			break;
+
+		// neighbours hold adjacent keys, so appending keeps both lists sorted
+		QVector<Range> merged((vRanges.size() + 1) / 2);
+		for (int i = 0; i < vRanges.size(); i++)
+		{
+			merged[i / 2].vInput += vRanges[i].vInput;
+			merged[i / 2].vPalette += vRanges[i].vPalette;
+		}
+
+		vRanges = merged;
+	}
+}
+
+template <class Metric>
+AlgorithmBisectDistanceThreaded<Metric>::~AlgorithmBisectDistanceThreaded()
+{
+	// the worker writes into pCurrent, which the base destructor frees
+	mWorker.waitForFinished();
+}
+
+template <class Metric>
+bool AlgorithmBisectDistanceThreaded<Metric>::setup(QImage *input, QImage *palette)
+{
+	mWorker.waitForFinished();
+
+	if (!AlgorithmSortBase::setup(input, palette))
+		return false;
+
+	auto before = [](const SortedPixel &p, float key)
+	{
+		return p.fD < key;
+	};
+
+	// Cuts at input quantiles, moved back to the first pixel of their key so
+	// equal keys never straddle two ranges. The palette is cut at the same keys.
+	// An image without pixels gets a single range, which is empty and dropped.
+	auto ranges = iCount > 0 ? qMax(1, QThread::idealThreadCount() * kRangesPerThread) : 1;
+	int inputEnd = 0;
+	int paletteEnd = 0;
+
+	vRanges.clear();
+	for (int r = 0; r < ranges; r++)
+	{
+		auto inputStart = inputEnd;
+		auto paletteStart = paletteEnd;
+
+		if (r == ranges - 1)
+		{
+			inputEnd = iCount;
+			paletteEnd = iCount;
+		}
+		else
+		{
+			auto key = vInput.at(int(qint64(iCount) * (r + 1) / ranges)).fD;
+			inputEnd = std::lower_bound(vInput.constBegin(), vInput.constEnd(), key, before) - vInput.constBegin();
+			paletteEnd = std::lower_bound(vPalette.constBegin(), vPalette.constEnd(), key, before) - vPalette.constBegin();
+		}
+
+		if (inputEnd == inputStart && paletteEnd == paletteStart)
+			continue;
+
+		Range range;
+		for (int i = inputStart; i < inputEnd; i++)
+			range.vInput.append(i);
+		for (int i = paletteStart; i < paletteEnd; i++)
+			range.vPalette.append(i);
+
+		vRanges.append(range);
+	}
+
+	mWorker = QtConcurrent::run(this, &AlgorithmBisectDistanceThreaded::doWork);
+
+	return true;
+}
+
+template <class Metric>
+bool AlgorithmBisectDistanceThreaded<Metric>::update()
+{
+	// update() runs off the GUI thread, waiting beats polling in a loop
+	mWorker.waitForFinished();
+	bFinished = !isCancelled();
+
+	if (bFinished)
+		emit finished(pCurrent);
+	else
+		emit step();
+
+	return bFinished;
+}
+
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmIndexedReplace)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmBisectDistance)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmBisectDistanceQt)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmBisectDistanceThreaded)
@@ -1,97 +1,170 @@
-#ifndef ALGORITHMSORT_H
-#define ALGORITHMSORT_H
-
-#include "ialgorithm.h"
-#include "pixel.h"
-#include <QList>
-#include <QVector>
-#include <QColor>
-#include <QFuture>
-
-struct PixelPos
-{
-	public:
-		PixelPos()
-			: p(0)
-			, x(0)
-			, y(0)
-			, fD(0)
-		{
-		}
-
-		PixelPos(Pixel pc, int px, int py, DistanceFunction func = rtm_distance)
-			: p(pc)
-			, x(px)
-			, y(py)
-			, fD(func(pc, empty))
-		{
-		}
-
-		Pixel p;
-		int x;
-		int y;
-		double fD;
-};
-
-class AlgorithmSortBase : public IAlgorithm
-{
-	public:
-		AlgorithmSortBase();
-		virtual ~AlgorithmSortBase();
-
-		virtual bool setup(QImage *input, QImage *palette, DistanceFunction func) override;
-
-		QList<PixelPos> vInput;
-		QList<PixelPos> vPalette;
-
-		int iCurPos;
-};
-
-class AlgorithmIndexedReplace : public AlgorithmSortBase
-{
-	public:
-		virtual bool update() override;
-		virtual QString name() override
-		{
-			return "Indexed Replace";
-		}
-};
-
-class AlgorithmBisectDistance : public AlgorithmSortBase
-{
-	public:
-		virtual bool update() override;
-		virtual QString name() override
-		{
-			return "Single Bisect";
-		}
-};
-
-class AlgorithmBisectDistanceQt : public AlgorithmSortBase
-{
-	public:
-		virtual bool update() override;
-		virtual QString name() override
-		{
-			return "Single Bisect (Qt)";
-		}
-};
-
-class AlgorithmBisectDistanceThreaded : public AlgorithmSortBase
-{
-	public:
-		virtual bool setup(QImage *input, QImage *palette, DistanceFunction func) override;
-		virtual bool update() override;
-		virtual QString name() override
-		{
-			return "Threaded Bisect";
-		}
-
-		void doWork(QList<PixelPos> palette, int id);
-
-		int iWorkers;
-		QVector<QList<PixelPos>> mThreadPalette;
-		QVector<QFuture<void>> mThreadWorker;
-};
-
-#endif // ALGORITHMSORT_H
+#ifndef ALGORITHMSORT_H
+#define ALGORITHMSORT_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include "consumablekeys.h"
+#include "pixel.h"
+#include "pixellist.h"
+#include <QVector>
+#include <QColor>
+#include <QFuture>
+
+class AlgorithmSortBase : public IAlgorithm
+{
+	public:
+		AlgorithmSortBase();
+		virtual ~AlgorithmSortBase();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+
+		QVector<SortedPixel> vInput;	// iIndex
+		QVector<SortedPixel> vPalette;	// c
+
+		int iCurPos;
+
+	protected:
+		// Sort keys of a list of colors, see colorKeys.
+		virtual ColorKeysFunction keyFunction() const = 0;
+
+		// fD of count entries of a sorted list, starting at first.
+		static QVector<double> sortKeys(const QVector<SortedPixel> &list, int first, int count);
+
+		// Colors of the last pixel written and their distance. Sorted lists
+		// keep the pixels of a color together, so runs of one pair are common.
+		struct LastPair
+		{
+			LastPair();
+
+			QRgb iInput;
+			QRgb iPalette;
+			double fDistance;
+			bool bValid;
+		};
+
+		// setResult, measuring the error once per run of the same pair of colors.
+		void setSorted(int i, QRgb c, LastPair &last, ErrorTracker::Changes &changes)
+		{
+			auto input = mInputView.at(i);
+			if (!last.bValid || last.iInput != input || last.iPalette != c)
+			{
+				last.iInput = input;
+				last.iPalette = c;
+				last.fDistance = mError.distance(Pixel(input), Pixel(c));
+				last.bValid = true;
+			}
+
+			setResult(i, c, last.fDistance, changes);
+		}
+};
+
+// Sorted palette keys that each input pixel consumes from, see ConsumableKeys.
+class AlgorithmBisectBase : public AlgorithmSortBase
+{
+	public:
+		virtual bool setup(QImage *input, QImage *palette) override;
+
+	protected:
+		ConsumableKeys mPaletteKeys;
+};
+
+template <class Metric>
+class AlgorithmIndexedReplace : public AlgorithmSortBase
+{
+	public:
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Indexed Replace";
+		}
+
+	protected:
+		virtual ColorKeysFunction keyFunction() const override
+		{
+			return colorKeys<Metric>;
+		}
+};
+
+template <class Metric>
+class AlgorithmBisectDistance : public AlgorithmBisectBase
+{
+	public:
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Single Bisect";
+		}
+
+	protected:
+		virtual ColorKeysFunction keyFunction() const override
+		{
+			return colorKeys<Metric>;
+		}
+};
+
+template <class Metric>
+class AlgorithmBisectDistanceQt : public AlgorithmBisectBase
+{
+	public:
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Single Bisect (Qt)";
+		}
+
+	protected:
+		virtual ColorKeysFunction keyFunction() const override
+		{
+			return colorKeys<Metric>;
+		}
+};
+
+// Bisect on all cores. The sorted input is cut by key into many small ranges,
+// each with the palette keys that fall inside it, and the thread pool hands
+// the ranges to whichever thread is free, so a dense range does not hold the
+// others back. Inside a range the picks are the ones the single bisect makes
+// over that range's palette keys. What a range cannot match, its inputs past
+// its last palette key or palette keys nobody took, is merged with its
+// neighbour and matched again, pairwise, until a single range is left.
+template <class Metric>
+class AlgorithmBisectDistanceThreaded : public AlgorithmSortBase
+{
+	public:
+		virtual ~AlgorithmBisectDistanceThreaded();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Threaded Bisect";
+		}
+
+		void doWork();
+
+		static const int kRangesPerThread = 16;
+
+		struct Range
+		{
+			QVector<int> vInput;	// indices in vInput, ascending keys
+			QVector<int> vPalette;	// indices in vPalette, ascending keys
+		};
+
+		QVector<Range> vRanges;
+		QFuture<void> mWorker;
+
+	protected:
+		// Matches what it can, leaves the rest in the range.
+		void match(Range &range);
+
+		virtual ColorKeysFunction keyFunction() const override
+		{
+			return colorKeys<Metric>;
+		}
+};
+
+DECLARE_METRIC_TEMPLATES(AlgorithmIndexedReplace)
+DECLARE_METRIC_TEMPLATES(AlgorithmBisectDistance)
+DECLARE_METRIC_TEMPLATES(AlgorithmBisectDistanceQt)
+DECLARE_METRIC_TEMPLATES(AlgorithmBisectDistanceThreaded)
+
+#endif // ALGORITHMSORT_H
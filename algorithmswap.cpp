@@ -1,36 +1,332 @@
-#include "algorithmswap.h"
-
-#include <QImage>
-#include <QColor>
-#include <QtConcurrent/QtConcurrent>
-
-bool AlgorithmSwapDistance::update()
-{
-	for (int i = 0; i < kUpdateSize; i++)
-		doStep();
-
-	emit step();
-
-	return false;
-}
-
-void AlgorithmSwapDistance::doStep()
-{
-	QPoint a(qrand() % iInputWidth, qrand() % iInputHeight);
-	QPoint b(qrand() % iPaletteWidth, qrand() % iPaletteHeight);
-
-	auto inputA = Pixel(pInput->pixel(a));
-	auto inputB = Pixel(pInput->pixel(b));
-	auto resultA = Pixel(pCurrent->pixel(a));
-	auto resultB = Pixel(pCurrent->pixel(b));
-
-	auto dAA = pDistance(inputA, resultA);
-	auto dBB = pDistance(inputB, resultB);
-	auto dAB = pDistance(inputA, resultB);
-	auto dBA = pDistance(inputB, resultA);
-	if (dAA + dBB > dAB + dBA)
-	{
-		pCurrent->setPixel(a, resultB.c);
-		pCurrent->setPixel(b, resultA.c);
-	}
-}
+#include "algorithmswap.h"
+
+#include <QImage>
+#include <QColor>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+
+template <class Metric>
+bool AlgorithmSwapDistance<Metric>::setup(QImage *input, QImage *palette)
+{
+	mInputCache.clear();
+	mPaletteCache.clear();
+
+	if (!IAlgorithm::setup(input, palette))
+		return false;
+
+	if (Metric::kSpace != kColorSpaceRGB)
+	{
+		mInputCache.build(pInput, Metric::kSpace);
+		mPaletteCache.build(pCurrent, Metric::kSpace);
+	}
+
+	mRandom.setSeed((quint64(quint32(qrand())) << 32) ^ quint32(qrand()));
+
+	return true;
+}
+
+template <class Metric>
+bool AlgorithmSwapDistance<Metric>::update()
+{
+	ErrorTracker::Changes changes;
+	for (int i = 0; i < kUpdateSize; i++)
+		doStep(changes);
+
+	Counters::count(Counters::kCounterSwapsProposed, kUpdateSize);
+	Counters::count(Counters::kCounterDistances, 4 * kUpdateSize);
+
+	mError.apply(changes);
+
+	emit step();
+
+	return false;
+}
+
+template <class Metric>
+void AlgorithmSwapDistance<Metric>::doStep(ErrorTracker::Changes &changes)
+{
+	// both points index pCurrent, which has the input dimensions
+	QPoint a(mRandom.bounded(iInputWidth), mRandom.bounded(iInputHeight));
+	QPoint b(mRandom.bounded(iInputWidth), mRandom.bounded(iInputHeight));
+
+	trySwap(a.x(), a.y(), b.x(), b.y(), changes);
+}
+
+template <class Metric>
+void AlgorithmSwapDistance<Metric>::trySwap(int ax, int ay, int bx, int by, ErrorTracker::Changes &changes)
+{
+	auto ia = ay * iInputWidth + ax;
+	auto ib = by * iInputWidth + bx;
+
+	auto inputA = Metric::color(mInputView, mInputCache, ia);
+	auto inputB = Metric::color(mInputView, mInputCache, ib);
+	auto resultA = Metric::color(mCurrentView, mPaletteCache, ia);
+	auto resultB = Metric::color(mCurrentView, mPaletteCache, ib);
+
+	auto dAA = Metric::distance(inputA, resultA);
+	auto dBB = Metric::distance(inputB, resultB);
+	auto dAB = Metric::distance(inputA, resultB);
+	auto dBA = Metric::distance(inputB, resultA);
+	if (dAA + dBB > dAB + dBA)
+	{
+		auto pixelA = mCurrentView.at(ia);
+		mCurrentView.set(ia, mCurrentView.at(ib));
+		mCurrentView.set(ib, pixelA);
+
+		// the distances just compared are the new errors, no need to measure
+		mError.set(ia, dAB, changes);
+		mError.set(ib, dBA, changes);
+		mDirty.mark(ax, ay);
+		mDirty.mark(bx, by);
+
+		Counters::count(Counters::kCounterSwapsAccepted);
+
+		if (Metric::kSpace != kColorSpaceRGB)
+			mPaletteCache.swap(ia, ib);
+	}
+}
+
+template <class Metric>
+AlgorithmSwapDistanceThreaded<Metric>::AlgorithmSwapDistanceThreaded()
+	: vBands()
+	, iSeed(0)
+	, iEpoch(0)
+	, iWorkers(QThread::idealThreadCount())
+{
+}
+
+template <class Metric>
+bool AlgorithmSwapDistanceThreaded<Metric>::setup(QImage *input, QImage *palette)
+{
+	if (!AlgorithmSwapDistance<Metric>::setup(input, palette))
+		return false;
+
+	// two draws, so the seed option alone picks the whole sequence
+	iSeed = (quint64(quint32(qrand())) << 32) ^ quint32(qrand());
+	iEpoch = 0;
+	vBands.fill(QVector<int>(), qMax(iWorkers, 1));
+
+	return true;
+}
+
+template <class Metric>
+bool AlgorithmSwapDistanceThreaded<Metric>::update()
+{
+	auto bands = (this->iInputHeight + kBandHeight - 1) / kBandHeight;
+
+	QVector<int> order(bands);
+	for (int i = 0; i < bands; i++)
+		order[i] = i;
+
+	FastRandom shuffle(iSeed ^ FastRandom::mix(iEpoch));
+	for (int i = bands - 1; i > 0; i--)
+		std::swap(order[i], order[shuffle.bounded(i + 1)]);
+
+	for (auto &list : vBands)
+		list.clear();
+
+	for (int i = 0; i < bands; i++)
+		vBands[i % vBands.size()].append(order[i]);
+
+	QVector<int> workers(vBands.size());
+	for (int i = 0; i < workers.size(); i++)
+		workers[i] = i;
+
+	QtConcurrent::blockingMap(workers, [this](int &id)
+	{
+		doWork(id);
+	});
+
+	iEpoch++;
+	emit this->step();
+
+	return false;
+}
+
+template <class Metric>
+void AlgorithmSwapDistanceThreaded<Metric>::doWork(int id)
+{
+	const auto &bands = vBands.at(id);
+	if (bands.isEmpty())
+		return;
+
+	FastRandom rng(FastRandom::mix(iSeed ^ FastRandom::mix(iEpoch)) + id);
+
+	auto width = this->iInputWidth;
+	auto height = this->iInputHeight;
+	auto pick = [&](int &x, int &y)
+	{
+		auto first = bands.at(rng.bounded(bands.size())) * kBandHeight;
+		auto rows = height - first;
+		if (rows > kBandHeight)
+			rows = kBandHeight;
+
+		x = rng.bounded(width);
+		y = first + rng.bounded(rows);
+	};
+
+	CounterScope scope(this->mCounters);
+	ErrorTracker::Changes changes;
+	for (int i = 0; i < kEpochSize; i++)
+	{
+		int ax, ay, bx, by;
+		pick(ax, ay);
+		pick(bx, by);
+		this->trySwap(ax, ay, bx, by, changes);
+	}
+
+	this->mError.apply(changes);
+	Counters::count(Counters::kCounterSwapsProposed, kEpochSize);
+	Counters::count(Counters::kCounterDistances, 4 * kEpochSize);
+}
+
+// Mean color of the size x size tile at x, y, channel by channel.
+static Pixel tileMean(const ConstImageView &img, int x, int y, int size)
+{
+	quint64 sum[4] = { 0, 0, 0, 0 };
+	for (int ty = y; ty < y + size; ty++)
+	{
+		auto line = img.row(ty);
+		for (int tx = x; tx < x + size; tx++)
+		{
+			auto p = Pixel(line[tx]);
+			sum[0] += p.r;
+			sum[1] += p.g;
+			sum[2] += p.b;
+			sum[3] += p.a;
+		}
+	}
+
+	auto n = quint64(size) * size;
+	Pixel mean;
+	mean.r = uchar((sum[0] + n / 2) / n);
+	mean.g = uchar((sum[1] + n / 2) / n);
+	mean.b = uchar((sum[2] + n / 2) / n);
+	mean.a = uchar((sum[3] + n / 2) / n);
+	return mean;
+}
+
+template <class Metric>
+AlgorithmSwapPyramid<Metric>::AlgorithmSwapPyramid()
+	: vInputMeans()
+	, vResultMeans()
+	, iLevelProposals(0)
+	, iLevel(0)
+	, iTilesX(0)
+	, iTilesY(0)
+{
+}
+
+template <class Metric>
+bool AlgorithmSwapPyramid<Metric>::setup(QImage *input, QImage *palette)
+{
+	if (!AlgorithmSwapDistance<Metric>::setup(input, palette))
+		return false;
+
+	auto level = 0;
+	while ((this->iInputWidth >> (level + 1)) * (this->iInputHeight >> (level + 1)) >= kMinTiles)
+		level++;
+
+	startLevel(level);
+
+	return true;
+}
+
+template <class Metric>
+void AlgorithmSwapPyramid<Metric>::startLevel(int level)
+{
+	iLevel = level;
+	vInputMeans.clear();
+	vResultMeans.clear();
+
+	if (level == 0)
+		return;
+
+	TraceScope trace("level");
+	trace.setArg("level", level);
+
+	auto size = 1 << level;
+	iTilesX = this->iInputWidth >> level;
+	iTilesY = this->iInputHeight >> level;
+	iLevelProposals = qint64(iTilesX) * iTilesY * kProposalsPerTile;
+
+	ConstImageView result = this->mCurrentView;
+	vInputMeans.resize(iTilesX * iTilesY);
+	vResultMeans.resize(iTilesX * iTilesY);
+	for (int t = 0, y = 0; y < iTilesY; y++)
+	{
+		for (int x = 0; x < iTilesX; x++, t++)
+		{
+			vInputMeans[t] = Metric::convert(tileMean(this->mInputView, x * size, y * size, size));
+			vResultMeans[t] = Metric::convert(tileMean(result, x * size, y * size, size));
+		}
+	}
+}
+
+template <class Metric>
+bool AlgorithmSwapPyramid<Metric>::update()
+{
+	if (iLevel == 0)
+		return AlgorithmSwapDistance<Metric>::update();
+
+	ErrorTracker::Changes changes;
+	auto tiles = iTilesX * iTilesY;
+	for (int i = 0; i < IAlgorithm::kUpdateSize; i++)
+		trySwapTiles(this->mRandom.bounded(tiles), this->mRandom.bounded(tiles), changes);
+
+	Counters::count(Counters::kCounterSwapsProposed, IAlgorithm::kUpdateSize);
+	Counters::count(Counters::kCounterDistances, 4 * IAlgorithm::kUpdateSize);
+
+	this->mError.apply(changes);
+
+	iLevelProposals -= IAlgorithm::kUpdateSize;
+	if (iLevelProposals <= 0)
+		startLevel(iLevel - 1);
+
+	emit this->step();
+
+	return false;
+}
+
+template <class Metric>
+void AlgorithmSwapPyramid<Metric>::trySwapTiles(int a, int b, ErrorTracker::Changes &changes)
+{
+	auto dAA = Metric::distance(vInputMeans[a], vResultMeans[a]);
+	auto dBB = Metric::distance(vInputMeans[b], vResultMeans[b]);
+	auto dAB = Metric::distance(vInputMeans[a], vResultMeans[b]);
+	auto dBA = Metric::distance(vInputMeans[b], vResultMeans[a]);
+	if (!(dAA + dBB > dAB + dBA))
+		return;
+
+	auto size = 1 << iLevel;
+	auto width = this->iInputWidth;
+	auto ia = (a / iTilesX) * size * width + (a % iTilesX) * size;
+	auto ib = (b / iTilesX) * size * width + (b % iTilesX) * size;
+
+	for (int y = 0; y < size; y++, ia += width - size, ib += width - size)
+	{
+		for (int x = 0; x < size; x++, ia++, ib++)
+		{
+			auto pixelA = this->mCurrentView.at(ia);
+			this->mCurrentView.set(ia, this->mCurrentView.at(ib));
+			this->mCurrentView.set(ib, pixelA);
+
+			if (Metric::kSpace != kColorSpaceRGB)
+				this->mPaletteCache.swap(ia, ib);
+
+			this->mError.set(ia, this->cachedError(ia), changes);
+			this->mError.set(ib, this->cachedError(ib), changes);
+			this->mDirty.mark(ia);
+			this->mDirty.mark(ib);
+		}
+	}
+
+	std::swap(vResultMeans[a], vResultMeans[b]);
+
+	Counters::count(Counters::kCounterSwapsAccepted);
+	Counters::count(Counters::kCounterDistances, 2 * size * size);
+}
+
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmSwapDistance)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmSwapDistanceThreaded)
+INSTANTIATE_METRIC_TEMPLATES(AlgorithmSwapPyramid)
@@ -1,18 +1,129 @@
-#ifndef ALGORITHMSWAP_H
-#define ALGORITHMSWAP_H
-
-#include "ialgorithm.h"
-
-class AlgorithmSwapDistance : public IAlgorithm
-{
-	public:
-		virtual bool update() override;
-		virtual QString name() override
-		{
-			return "Random Pixel Swap";
-		}
-
-		void doStep();
-};
-
-#endif // ALGORITHMSWAP_H
+#ifndef ALGORITHMSWAP_H
+#define ALGORITHMSWAP_H
+
+#include "ialgorithm.h"
+#include "metric.h"
+#include "fastrandom.h"
+#include <QVector>
+
+template <class Metric>
+class AlgorithmSwapDistance : public IAlgorithm
+{
+	public:
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Random Pixel Swap";
+		}
+
+		virtual ColorSpace colorSpace() const override
+		{
+			return Metric::kSpace;
+		}
+
+		virtual bool finishes() const override
+		{
+			return false;
+		}
+
+		void doStep(ErrorTracker::Changes &changes);
+
+	protected:
+		// Swaps the result pixels at a and b when both get closer to the input.
+		void trySwap(int ax, int ay, int bx, int by, ErrorTracker::Changes &changes);
+
+		// Distance of result pixel i to its input, from the caches.
+		double cachedError(int i) const
+		{
+			return Metric::distance(Metric::color(mInputView, mInputCache, i), Metric::color(mCurrentView, mPaletteCache, i));
+		}
+
+		// Converted coordinates in the scalar type of the metric, empty for
+		// RGB metrics. mPaletteCache is built from pCurrent as IAlgorithm::setup
+		// leaves it and swapped along with its pixels.
+		typename Metric::Cache mInputCache;
+		typename Metric::Cache mPaletteCache;
+
+		// Seeded from qrand() at setup, which only reaches RAND_MAX (32767 on
+		// some platforms) and would leave the rest of a wide image untouched.
+		FastRandom mRandom;
+};
+
+// Random Pixel Swap on every core. Each update is one epoch: the rows are
+// cut in bands, the bands shuffled and dealt to the workers, and every worker
+// proposes swaps between pixels of its own bands only. No two workers touch
+// the same pixel, so there is no locking, and since the shuffle changes every
+// epoch any two pixels share a worker sooner or later.
+//
+// Each worker has its own FastRandom, seeded from qrand() at setup, the epoch
+// and the worker index, so a seed and a thread count give the same result.
+template <class Metric>
+class AlgorithmSwapDistanceThreaded : public AlgorithmSwapDistance<Metric>
+{
+	public:
+		AlgorithmSwapDistanceThreaded();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Threaded Pixel Swap";
+		}
+
+		static const int kBandHeight = 8;
+		static const int kEpochSize = 16 * IAlgorithm::kUpdateSize; // proposals per worker
+
+	protected:
+		void doWork(int id);
+
+		QVector<QVector<int>> vBands; // per worker, for the current epoch
+		quint64 iSeed;
+		int iEpoch;
+		int iWorkers;
+};
+
+// Random Pixel Swap from coarse to fine. The result is first arranged in tiles
+// of 2^k x 2^k pixels: two tiles trade all their pixels when their mean colors
+// get closer to the means of the input under them, which moves whole regions
+// across the image in one proposal, where pixel pairs would take ages. Every
+// level gets a number of proposals per tile, then the tiles are halved, the
+// arrangement so far being the start of the finer level, down to single
+// pixels, where it goes on as Random Pixel Swap. Pixels of the partial tiles
+// along the right and bottom edges only move at the finer levels.
+template <class Metric>
+class AlgorithmSwapPyramid : public AlgorithmSwapDistance<Metric>
+{
+	public:
+		AlgorithmSwapPyramid();
+
+		virtual bool setup(QImage *input, QImage *palette) override;
+		virtual bool update() override;
+		virtual QString name() override
+		{
+			return "Pyramid Pixel Swap";
+		}
+
+		static const int kMinTiles = 64;		// at the coarsest level
+		static const int kProposalsPerTile = 16;
+
+	protected:
+		typedef typename Metric::Color Color;
+
+		// Tiles of 1 << level pixels, means measured again.
+		void startLevel(int level);
+		void trySwapTiles(int a, int b, ErrorTracker::Changes &changes);
+
+		QVector<Color> vInputMeans;		// per tile of the current level
+		QVector<Color> vResultMeans;
+		qint64 iLevelProposals;			// left at the current level
+		int iLevel;						// 0 is single pixels
+		int iTilesX;
+		int iTilesY;
+};
+
+DECLARE_METRIC_TEMPLATES(AlgorithmSwapDistance)
+DECLARE_METRIC_TEMPLATES(AlgorithmSwapDistanceThreaded)
+DECLARE_METRIC_TEMPLATES(AlgorithmSwapPyramid)
+
+#endif // ALGORITHMSWAP_H
@@ -0,0 +1,524 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDir>
+#include <QImage>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "distancebatch.h"
+#include "pixel.h"
+
+#if defined(Q_OS_LINUX)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+// Indirect call, for comparison with the per-metric specializations.
+typedef std::function<double(Pixel, Pixel)> DistanceFunction;
+
+struct PixelStream
+{
+	QString sName;
+	QVector<Pixel> vA;
+	QVector<Pixel> vB;
+};
+
+struct BenchCounters
+{
+	bool bValid;
+	quint64 iCycles;
+	quint64 iCacheMisses;
+	quint64 iBranchMisses;
+};
+
+// Hardware counters through perf_event_open, silently unavailable elsewhere or
+// when the kernel refuses (perf_event_paranoid, containers).
+class PerfCounters
+{
+	public:
+		PerfCounters(bool enabled)
+		{
+			for (int i = 0; i < kCount; i++)
+				iFd[i] = -1;
+
+#if defined(Q_OS_LINUX)
+			if (!enabled)
+				return;
+
+			static const quint64 config[kCount] = {
+				PERF_COUNT_HW_CPU_CYCLES,
+				PERF_COUNT_HW_CACHE_MISSES,
+				PERF_COUNT_HW_BRANCH_MISSES
+			};
+
+			for (int i = 0; i < kCount; i++)
+			{
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.size = sizeof(attr);
+				attr.config = config[i];
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				iFd[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+			}
+#else
+			Q_UNUSED(enabled);
+#endif
+		}
+
+		~PerfCounters()
+		{
+#if defined(Q_OS_LINUX)
+			for (int i = 0; i < kCount; i++)
+			{
+				if (iFd[i] >= 0)
+					close(iFd[i]);
+			}
+#endif
+		}
+
+		bool valid() const
+		{
+			for (int i = 0; i < kCount; i++)
+			{
+				if (iFd[i] < 0)
+					return false;
+			}
+
+			return true;
+		}
+
+		void start()
+		{
+#if defined(Q_OS_LINUX)
+			for (int i = 0; i < kCount; i++)
+			{
+				if (iFd[i] < 0)
+					continue;
+
+				ioctl(iFd[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl(iFd[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		BenchCounters stop()
+		{
+			quint64 v[kCount] = {0, 0, 0};
+#if defined(Q_OS_LINUX)
+			for (int i = 0; i < kCount; i++)
+			{
+				if (iFd[i] < 0)
+					continue;
+
+				ioctl(iFd[i], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(iFd[i], &v[i], sizeof(v[i])) != sizeof(v[i]))
+					v[i] = 0;
+			}
+#endif
+			return {valid(), v[0], v[1], v[2]};
+		}
+
+	private:
+		static const int kCount = 3;
+		int iFd[kCount];
+};
+
+static QVector<Pixel> loadPixels(const QString &file)
+{
+	QVector<Pixel> v;
+	QImage img(file);
+	if (img.isNull())
+		return v;
+
+	v.reserve(img.width() * img.height());
+	for (int y = 0; y < img.height(); y++)
+	{
+		for (int x = 0; x < img.width(); x++)
+			v.append(Pixel(img.pixel(x, y)));
+	}
+
+	return v;
+}
+
+static Pixel randomPixel()
+{
+	return Pixel((qrand() & 0xff) | ((qrand() & 0xff) << 8) | ((qrand() & 0xff) << 16) | 0xff000000);
+}
+
+static Pixel makePixel(int r, int g, int b)
+{
+	Pixel p;
+	p.r = r;
+	p.g = g;
+	p.b = b;
+	p.a = 0xff;
+	return p;
+}
+
+static QList<PixelStream> createStreams(const QString &imageDir, int count)
+{
+	QList<PixelStream> streams;
+
+	// Real photos: pair every image against the next one, like input vs palette.
+	QDir dir(imageDir);
+	auto files = dir.entryList(QStringList() << "*.png", QDir::Files, QDir::Name);
+	for (int i = 0; i + 1 < files.size(); i += 2)
+	{
+		auto a = loadPixels(dir.filePath(files.at(i)));
+		auto b = loadPixels(dir.filePath(files.at(i + 1)));
+		auto n = std::min(count, std::min(a.size(), b.size()));
+		if (n == 0)
+			continue;
+
+		PixelStream s;
+		s.sName = files.at(i) + " x " + files.at(i + 1);
+		s.vA = a.mid(0, n);
+		s.vB = b.mid(0, n);
+		streams.append(s);
+	}
+
+	PixelStream uniform;
+	uniform.sName = "uniform random";
+
+	// Greys have zero chroma, hitting the C'1 * C'2 == 0 branches of CIEDE2000.
+	PixelStream grey;
+	grey.sName = "greys";
+
+	// Opposite hues force the h_bar > 180 wrap-around paths.
+	PixelStream hue;
+	hue.sName = "opposite hues";
+
+	// Dark values stay below the sRGB linear threshold, everything else hits pow().
+	PixelStream dark;
+	dark.sName = "dark (no pow)";
+
+	for (int i = 0; i < count; i++)
+	{
+		uniform.vA.append(randomPixel());
+		uniform.vB.append(randomPixel());
+
+		auto g1 = qrand() & 0xff;
+		auto g2 = qrand() & 0xff;
+		grey.vA.append(makePixel(g1, g1, g1));
+		grey.vB.append(makePixel(g2, g2, g2));
+
+		auto v = 64 + (qrand() % 192);
+		hue.vA.append(makePixel(v, qrand() % 32, v / 2));
+		hue.vB.append(makePixel(qrand() % 32, v, v / 2));
+
+		dark.vA.append(makePixel(qrand() % 10, qrand() % 10, qrand() % 10));
+		dark.vB.append(makePixel(qrand() % 10, qrand() % 10, qrand() % 10));
+	}
+
+	streams.append(uniform);
+	streams.append(grey);
+	streams.append(hue);
+	streams.append(dark);
+
+	return streams;
+}
+
+// The result is accumulated and printed so the calls cannot be optimized away.
+static volatile double gSink = 0;
+
+template <class T, T (*F)(Pixel, Pixel)>
+static double runDirect(const PixelStream &s)
+{
+	double sum = 0;
+	auto a = s.vA.constData();
+	auto b = s.vB.constData();
+	for (int i = 0, n = s.vA.size(); i < n; i++)
+		sum += F(a[i], b[i]);
+
+	return sum;
+}
+
+static double runIndirect(const PixelStream &s, const DistanceFunction &func)
+{
+	double sum = 0;
+	auto a = s.vA.constData();
+	auto b = s.vB.constData();
+	for (int i = 0, n = s.vA.size(); i < n; i++)
+		sum += func(a[i], b[i]);
+
+	return sum;
+}
+
+struct Kernel
+{
+	QString sName;
+	std::function<double(const PixelStream &)> pDirect;
+	DistanceFunction pIndirect;
+};
+
+// A formula in both scalar types, for the precision report.
+struct PrecisionKernel
+{
+	QString sName;
+	std::function<double(const PixelStream &)> pDouble;
+	std::function<double(const PixelStream &)> pFloat;
+	double (*pDoubleDistance)(Pixel, Pixel);
+	float (*pFloatDistance)(Pixel, Pixel);
+};
+
+template <class F>
+static qint64 fastest(int repeat, F run)
+{
+	qint64 best = -1;
+	for (int r = 0; r < repeat; r++)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		gSink = gSink + run();
+		auto ns = timer.nsecsElapsed();
+
+		if (best < 0 || ns < best)
+			best = ns;
+	}
+
+	return best;
+}
+
+// How far the float form strays from the double one over a stream: largest
+// and mean relative error, and the share of swap decisions they take alike.
+// Decisions pair up consecutive entries like Random Pixel Swap does: vA as
+// the input pixels, vB as the result pixels they currently hold.
+static void measurePrecision(const PrecisionKernel &k, const PixelStream &s, double &maxError, double &meanError, double &agree)
+{
+	auto a = s.vA.constData();
+	auto b = s.vB.constData();
+	auto n = s.vA.size();
+
+	maxError = 0;
+	meanError = 0;
+	for (int i = 0; i < n; i++)
+	{
+		auto d = k.pDoubleDistance(a[i], b[i]);
+		auto f = double(k.pFloatDistance(a[i], b[i]));
+		auto error = std::abs(f - d) / std::max(std::abs(d), 1e-9);
+
+		// undefined in both, like the hue of a grey, is a match
+		if (std::isnan(d) || std::isnan(f))
+			error = std::isnan(d) && std::isnan(f) ? 0 : 1;
+
+		maxError = std::max(maxError, error);
+		meanError += error;
+	}
+
+	meanError /= std::max(n, 1);
+
+	int same = 0;
+	int decisions = 0;
+	for (int i = 0; i + 1 < n; i += 2, decisions++)
+	{
+		auto swapDouble = k.pDoubleDistance(a[i], b[i]) + k.pDoubleDistance(a[i + 1], b[i + 1])
+			> k.pDoubleDistance(a[i], b[i + 1]) + k.pDoubleDistance(a[i + 1], b[i]);
+		auto swapFloat = k.pFloatDistance(a[i], b[i]) + k.pFloatDistance(a[i + 1], b[i + 1])
+			> k.pFloatDistance(a[i], b[i + 1]) + k.pFloatDistance(a[i + 1], b[i]);
+		same += swapDouble == swapFloat;
+	}
+
+	agree = decisions > 0 ? double(same) / decisions : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("RTM-bench");
+
+	QTextStream out(stdout);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Microbenchmark of the pixel distance kernels.");
+	parser.addHelpOption();
+
+	QCommandLineOption imagesOption(QStringList() << "images", "Directory with sample png images.", "dir", "images");
+	QCommandLineOption countOption(QStringList() << "n" << "count", "Pixel pairs per stream.", "count", "262144");
+	QCommandLineOption repeatOption(QStringList() << "r" << "repeat", "Repetitions, the fastest one is reported.", "count", "5");
+	QCommandLineOption perfOption(QStringList() << "perf", "Read cycles, cache and branch misses through perf_event_open.");
+	parser.addOption(imagesOption);
+	parser.addOption(countOption);
+	parser.addOption(repeatOption);
+	parser.addOption(perfOption);
+	parser.process(app);
+
+	qsrand(1);
+
+	auto count = std::max(1, parser.value(countOption).toInt());
+	auto repeat = std::max(1, parser.value(repeatOption).toInt());
+	auto streams = createStreams(parser.value(imagesOption), count);
+
+	QList<Kernel> kernels;
+	kernels.append({"rtm_distance", runDirect<double, rtm_distance<double>>, rtm_distance<double>});
+	kernels.append({"cmetric", runDirect<double, cmetric>, cmetric});
+	kernels.append({"ciede2000", runDirect<double, ciede2000<double>>, ciede2000<double>});
+	kernels.append({"cie1976", runDirect<double, cie1976<double>>, cie1976<double>});
+	kernels.append({"hue_distance", runDirect<double, hue_distance<double>>, hue_distance<double>});
+
+	PerfCounters perf(parser.isSet(perfOption));
+	if (parser.isSet(perfOption) && !perf.valid())
+		out << "perf_event_open unavailable, hardware counters disabled" << endl;
+
+	out << "kernel\tstream\tcall\tns/call\tMpairs/s";
+	if (perf.valid())
+		out << "\tcycles/call\tcache-miss/call\tbranch-miss/call";
+	out << endl;
+
+	for (auto kernel : kernels)
+	{
+		for (auto stream : streams)
+		{
+			for (int mode = 0; mode < 2; mode++)
+			{
+				qint64 best = -1;
+				BenchCounters bestCounters = {false, 0, 0, 0};
+
+				for (int r = 0; r < repeat; r++)
+				{
+					QElapsedTimer timer;
+					perf.start();
+					timer.start();
+					gSink = gSink + (mode == 0 ? kernel.pDirect(stream) : runIndirect(stream, kernel.pIndirect));
+					auto ns = timer.nsecsElapsed();
+					auto counters = perf.stop();
+
+					if (best < 0 || ns < best)
+					{
+						best = ns;
+						bestCounters = counters;
+					}
+				}
+
+				auto calls = double(stream.vA.size());
+				out << kernel.sName << "\t" << stream.sName << "\t" << (mode == 0 ? "direct" : "std::function")
+					<< "\t" << best / calls
+					<< "\t" << calls / (best / 1000.0);
+
+				if (bestCounters.bValid)
+				{
+					out << "\t" << bestCounters.iCycles / calls
+						<< "\t" << bestCounters.iCacheMisses / calls
+						<< "\t" << bestCounters.iBranchMisses / calls;
+				}
+
+				out << endl;
+			}
+		}
+	}
+
+	// Batch kernels over the same pairs, once per instruction set up to the supported one.
+	typedef void (*PairsFunction)(const Pixel *, const Pixel *, double *, int);
+	QList<QPair<QString, PairsFunction>> batches;
+	batches.append(qMakePair(QString("rtm_distance_pairs"), PairsFunction(rtm_distance_pairs)));
+	batches.append(qMakePair(QString("cmetric_pairs"), PairsFunction(cmetric_pairs)));
+
+	auto supported = simdLevel();
+	for (auto batch : batches)
+	{
+		for (auto stream : streams)
+		{
+			QVector<double> results(stream.vA.size());
+			for (int level = kSimdScalar; level <= supported; level++)
+			{
+				setSimdLevel(SimdLevel(level));
+
+				qint64 best = -1;
+				for (int r = 0; r < repeat; r++)
+				{
+					QElapsedTimer timer;
+					timer.start();
+					batch.second(stream.vA.constData(), stream.vB.constData(), results.data(), results.size());
+					auto ns = timer.nsecsElapsed();
+					gSink = gSink + results[0];
+
+					if (best < 0 || ns < best)
+						best = ns;
+				}
+
+				auto calls = double(stream.vA.size());
+				out << batch.first << "\t" << stream.sName << "\t" << simdLevelName(SimdLevel(level))
+					<< "\t" << best / calls
+					<< "\t" << calls / (best / 1000.0) << endl;
+			}
+		}
+	}
+	setSimdLevel(supported);
+
+	// Float forms against the double ones: time per call of both, relative
+	// error of the float distance and how often a swap decision flips.
+	QList<PrecisionKernel> precision;
+	precision.append({"rtm_distance", runDirect<double, rtm_distance<double>>, runDirect<float, rtm_distance<float>>, rtm_distance<double>, rtm_distance<float>});
+	precision.append({"ciede2000", runDirect<double, ciede2000<double>>, runDirect<float, ciede2000<float>>, ciede2000<double>, ciede2000<float>});
+	precision.append({"cie1976", runDirect<double, cie1976<double>>, runDirect<float, cie1976<float>>, cie1976<double>, cie1976<float>});
+	precision.append({"hue_distance", runDirect<double, hue_distance<double>>, runDirect<float, hue_distance<float>>, hue_distance<double>, hue_distance<float>});
+
+	out << endl << "kernel\tstream\tdouble ns/call\tfloat ns/call\tspeedup\tmax rel err\tmean rel err\tswaps agree" << endl;
+
+	for (auto kernel : precision)
+	{
+		for (auto stream : streams)
+		{
+			auto timeDouble = fastest(repeat, [&]() { return kernel.pDouble(stream); });
+			auto timeFloat = fastest(repeat, [&]() { return kernel.pFloat(stream); });
+
+			double maxError, meanError, agree;
+			measurePrecision(kernel, stream, maxError, meanError, agree);
+
+			auto calls = double(stream.vA.size());
+			out << kernel.sName << "\t" << stream.sName
+				<< "\t" << timeDouble / calls
+				<< "\t" << timeFloat / calls
+				<< "\t" << double(timeDouble) / std::max(timeFloat, qint64(1))
+				<< "\t" << maxError
+				<< "\t" << meanError
+				<< "\t" << agree << endl;
+		}
+	}
+
+	// Sort keys of the float forms through the batch kernels, at the supported level.
+	out << endl << "keys\tstream\tdouble ns/key\tfloat ns/key\tspeedup\tmax rel err" << endl;
+
+	for (auto stream : streams)
+	{
+		auto n = stream.vB.size();
+		QVector<double> keysDouble(n);
+		QVector<double> keysFloat(n);
+
+		auto timeDouble = fastest(repeat, [&]()
+		{
+			rtm_distance_batch(empty, stream.vB.constData(), keysDouble.data(), n);
+			return keysDouble[0];
+		});
+
+		auto timeFloat = fastest(repeat, [&]()
+		{
+			rtm_distance_batch_float(empty, stream.vB.constData(), keysFloat.data(), n);
+			return keysFloat[0];
+		});
+
+		double maxError = 0;
+		for (int i = 0; i < n; i++)
+			maxError = std::max(maxError, std::abs(keysFloat[i] - keysDouble[i]) / std::max(keysDouble[i], 1e-9));
+
+		out << "rtm_distance_batch\t" << stream.sName
+			<< "\t" << timeDouble / double(n)
+			<< "\t" << timeFloat / double(n)
+			<< "\t" << double(timeDouble) / std::max(timeFloat, qint64(1))
+			<< "\t" << maxError << endl;
+	}
+
+	out << "checksum: " << gSink << endl;
+
+	return 0;
+}
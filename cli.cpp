@@ -0,0 +1,448 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDateTime>
+#include <QScopedPointer>
+#include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "algorithmregistry.h"
+#include "tiledmatch.h"
+#include "paletteindex.h"
+#include "framesequence.h"
+
+static double toMs(qint64 ns)
+{
+	return ns / 1000000.0;
+}
+
+// <output path>/<output base name>.counters.json, returns false on error.
+static bool writeCounters(const QString &output, const QJsonObject &json)
+{
+	QFileInfo info(output);
+	QFile file(info.path() + "/" + info.completeBaseName() + ".counters.json");
+
+	return file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(json).toJson()) >= 0;
+}
+
+// pattern with its %d, or %0Nd for N digits, replaced by frame. Empty when it
+// has no such field.
+static QString frameName(const QString &pattern, int frame)
+{
+	auto start = pattern.indexOf('%');
+	auto end = start + 1;
+	while (start >= 0 && end < pattern.size() && pattern.at(end).isDigit())
+		end++;
+
+	if (start < 0 || end >= pattern.size() || pattern.at(end) != 'd')
+		return QString();
+
+	auto width = pattern.mid(start + 1, end - start - 1).toInt();
+	return pattern.left(start) + QString::number(frame).rightJustified(width, '0') + pattern.mid(end + 1);
+}
+
+// Accepts either the display name (case insensitive) or the list index.
+static int findByName(const QStringList &list, const QString &value)
+{
+	bool ok = false;
+	auto index = value.toInt(&ok);
+	if (ok)
+		return (index >= 0 && index < list.size()) ? index : -1;
+
+	for (int i = 0; i < list.size(); i++)
+	{
+		if (list.at(i).compare(value, Qt::CaseInsensitive) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+// Parsed command line, shared by the modes.
+struct Options
+{
+	QString sInput;
+	QString sPalette;
+	QString sOutput;
+	QString sErrorLog;
+	QString sTrace;				// empty without --trace
+	QString sPaletteIndex;		// empty without --palette-index
+	QString sTemp;
+	QString sFrames;
+	double fThreshold;
+	qint64 iMemory;				// bytes
+	int iTechnique;
+	int iDistance;
+	int iMaxSteps;
+	bool bCounters;
+};
+
+// Writes the counters next to output when asked to, then the trace. Returns
+// the exit code.
+static int writeReports(const Options &options, const QString &output, const QJsonObject &counters, QTextStream &err)
+{
+	if (options.bCounters && !writeCounters(output, counters))
+	{
+		err << "Could not write the counters of " << output << endl;
+		return 1;
+	}
+
+	if (!options.sTrace.isEmpty())
+	{
+		Trace::stop();
+		if (!Trace::save(options.sTrace))
+		{
+			err << "Could not write " << options.sTrace << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Out of core: no QImage, no technique instance, PPM in and out.
+static int runTiled(const Options &options, QTextStream &out, QTextStream &err)
+{
+	TiledMatch tiled;
+	tiled.setMemoryLimit(options.iMemory);
+	if (!options.sTemp.isEmpty())
+		tiled.setTempPath(options.sTemp);
+
+	QElapsedTimer total;
+	total.start();
+
+	if (!tiled.run(options.sInput, options.sPalette, options.sOutput, keyFunction(options.iDistance), distanceFunction(options.iDistance)))
+	{
+		err << tiled.errorString() << endl;
+		return 1;
+	}
+
+	auto distance = distanceList().at(options.iDistance);
+	auto times = tiled.counters().values().vNanoseconds;
+	out << "technique: Tiled Indexed Replace" << endl;
+	out << "distance:  " << distance << endl;
+	out << "pixels:    " << tiled.count() << endl;
+	out << "sort:      " << toMs(times[Counters::kPhaseSort]) << " ms" << endl;
+	out << "merge:     " << toMs(times[Counters::kPhaseMatch]) << " ms" << endl;
+	out << "write:     " << toMs(times[Counters::kPhaseWrite]) << " ms" << endl;
+	out << "total:     " << toMs(total.nsecsElapsed()) << " ms" << endl;
+	out << "error:     " << tiled.error() << " (" << tiled.error() / tiled.count() << " per pixel)" << endl;
+
+	auto json = tiled.counters().toJson();
+	json.insert("technique", QString("Tiled Indexed Replace"));
+	json.insert("distance", distance);
+	json.insert("pixels", double(tiled.count()));
+	json.insert("error", tiled.error());
+
+	return writeReports(options, options.sOutput, json, err);
+}
+
+// Frame sequence: each frame starts from the result of the one before.
+static int runFrames(const Options &options, QTextStream &out, QTextStream &err)
+{
+	auto range = options.sFrames.split('-');
+	auto first = range.value(0).toInt();
+	auto last = range.value(1).toInt();
+
+	if (range.size() != 2 || last < first || frameName(options.sInput, first).isEmpty() || frameName(options.sOutput, first).isEmpty())
+	{
+		err << "--frames takes first-last, and --input and --output a %d or %04d field." << endl;
+		return 1;
+	}
+
+	QImage palette(options.sPalette);
+	if (palette.isNull())
+	{
+		err << "Could not load " << options.sPalette << endl;
+		return 1;
+	}
+
+	FrameSequence sequence;
+	sequence.setTechnique(options.iTechnique, options.iDistance);
+	sequence.setThreshold(options.fThreshold);
+	sequence.setMaxSteps(options.iMaxSteps);
+	sequence.reset(palette);
+
+	QElapsedTimer total;
+	total.start();
+
+	for (int frame = first; frame <= last; frame++)
+	{
+		QElapsedTimer phase;
+		phase.start();
+
+		QImage input(frameName(options.sInput, frame));
+		if (input.isNull())
+		{
+			err << "Could not load " << frameName(options.sInput, frame) << endl;
+			return 1;
+		}
+
+		if (!sequence.next(input))
+		{
+			err << frameName(options.sInput, frame) << ": " << sequence.errorString() << endl;
+			return 1;
+		}
+
+		if (!sequence.result().save(frameName(options.sOutput, frame)))
+		{
+			err << "Could not write " << frameName(options.sOutput, frame) << endl;
+			return 1;
+		}
+
+		out << "frame " << frame << ": " << sequence.changed() << " changed, " << sequence.matched() << " matched, "
+			<< toMs(phase.nsecsElapsed()) << " ms, error " << sequence.error() << endl;
+	}
+
+	auto technique = techniqueList().at(options.iTechnique);
+	auto distance = distanceList().at(options.iDistance);
+	out << "technique: " << technique << endl;
+	out << "distance:  " << distance << endl;
+	out << "frames:    " << sequence.frames() << endl;
+	out << "total:     " << toMs(total.nsecsElapsed()) << " ms" << endl;
+
+	auto json = sequence.counters().toJson();
+	json.insert("technique", technique);
+	json.insert("distance", distance);
+	json.insert("frames", sequence.frames());
+
+	return writeReports(options, frameName(options.sOutput, first), json, err);
+}
+
+// One technique on one input, with the time of every phase.
+static int runSingle(const Options &options, QTextStream &out, QTextStream &err)
+{
+	auto distance = distanceList().at(options.iDistance);
+	QScopedPointer<IAlgorithm> algo(createAlgorithm(options.iTechnique, options.iDistance));
+
+	QElapsedTimer total;
+	QElapsedTimer phase;
+	total.start();
+
+	phase.start();
+	QImage input(options.sInput);
+	QImage palette(options.sPalette);
+	auto loadTime = phase.nsecsElapsed();
+
+	if (input.isNull() || palette.isNull())
+	{
+		err << "Could not load input or palette image, see --tiled for images larger than memory." << endl;
+		return 1;
+	}
+
+	// palette data shared by many runs, built once
+	PaletteIndex index;
+	qint64 indexTime = 0;
+	QString indexState;
+	if (!options.sPaletteIndex.isEmpty())
+	{
+		phase.start();
+		indexState = "loaded";
+
+		if (!index.load(options.sPaletteIndex) || !index.matches(&palette, distance))
+		{
+			indexState = "created";
+			if (!index.create(options.sPaletteIndex, &palette, distance, keyFunction(options.iDistance)))
+			{
+				err << index.errorString() << endl;
+				return 1;
+			}
+		}
+
+		algo->setPaletteIndex(&index);
+		indexTime = phase.nsecsElapsed();
+	}
+
+	phase.start();
+	bool ready;
+	{
+		CounterScope scope(algo->counters(), Counters::kPhaseSetup);
+		ready = algo->setup(&input, &palette);
+	}
+	auto setupTime = phase.nsecsElapsed();
+
+	if (!ready)
+	{
+		err << "Setup failed, the palette is empty." << endl;
+		return 1;
+	}
+
+	QFile errorFile;
+	QTextStream errorLog(&errorFile);
+	if (!options.sErrorLog.isEmpty())
+	{
+		errorFile.setFileName(options.sErrorLog);
+		if (!errorFile.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			err << "Could not write " << errorFile.fileName() << endl;
+			return 1;
+		}
+
+		errorLog << "update,ms,total" << endl;
+		errorLog << 0 << "," << 0 << "," << algo->error().total() << endl;
+	}
+
+	phase.start();
+	int steps = 0;
+	bool done = false;
+	while (!done && (algo->finishes() || steps < options.iMaxSteps))
+	{
+		done = algo->process();
+		steps++;
+
+		if (errorFile.isOpen())
+			errorLog << steps << "," << toMs(phase.nsecsElapsed()) << "," << algo->error().total() << endl;
+	}
+	auto processTime = phase.nsecsElapsed();
+
+	phase.start();
+	bool saved;
+	{
+		TraceScope trace("save");
+		saved = algo->result()->save(options.sOutput);
+	}
+	auto saveTime = phase.nsecsElapsed();
+	algo->counters().addTime(Counters::kPhaseWrite, saveTime);
+
+	out << "technique: " << algo->name() << endl;
+	out << "distance:  " << distance << endl;
+	out << "pixels:    " << input.width() * input.height() << endl;
+	out << "load:      " << toMs(loadTime) << " ms" << endl;
+	if (!index.isEmpty())
+		out << "index:     " << toMs(indexTime) << " ms (" << indexState << ")" << endl;
+	out << "setup:     " << toMs(setupTime) << " ms" << endl;
+	out << "process:   " << toMs(processTime) << " ms (" << steps << " updates)" << endl;
+	out << "save:      " << toMs(saveTime) << " ms" << endl;
+	out << "total:     " << toMs(total.nsecsElapsed()) << " ms" << endl;
+	out << "error:     " << algo->error().total() << " (" << algo->error().mean() << " per pixel)" << endl;
+
+	if (!saved)
+	{
+		err << "Could not write " << options.sOutput << endl;
+		return 1;
+	}
+
+	auto json = algo->counters().toJson();
+	json.insert("technique", algo->name());
+	json.insert("distance", distance);
+	json.insert("pixels", input.width() * input.height());
+	json.insert("updates", steps);
+	json.insert("error", algo->error().total());
+
+	return writeReports(options, options.sOutput, json, err);
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("RTM-cli");
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Rearrange the pixels of an input image using the colors of a palette image.");
+	parser.addHelpOption();
+
+	QCommandLineOption inputOption(QStringList() << "i" << "input", "Input image.", "file");
+	QCommandLineOption paletteOption(QStringList() << "p" << "palette", "Palette image, weighted to the input pixel count when it has another one.", "file");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Result image.", "file", "result.png");
+	QCommandLineOption techniqueOption(QStringList() << "t" << "technique", "Technique name or index.", "name", "0");
+	QCommandLineOption distanceOption(QStringList() << "d" << "distance", "Distance name or index.", "name", "0");
+	QCommandLineOption iterationsOption(QStringList() << "n" << "iterations", "Max update slices, for techniques that never finish, the others always run to the end.", "count", "1000");
+	QCommandLineOption seedOption(QStringList() << "s" << "seed", "Random seed, defaults to the current time.", "seed");
+	QCommandLineOption errorLogOption(QStringList() << "error-log", "Write the total error after every update slice as CSV.", "file");
+	QCommandLineOption countersOption(QStringList() << "counters", "Write hot path counters and phase times as JSON next to the result.");
+	QCommandLineOption traceOption(QStringList() << "trace", "Write a timeline of setup, workers and update slices as Chrome trace JSON.", "file");
+	QCommandLineOption paletteIndexOption(QStringList() << "palette-index", "Palette index to load, created first when missing or made for another palette or distance.", "file");
+	QCommandLineOption framesOption(QStringList() << "frames", "Match the frames first to last of a sequence, --input and --output hold %d or %04d for the frame number.", "first-last");
+	QCommandLineOption thresholdOption(QStringList() << "threshold", "With --frames, how far an input pixel may move from the previous frame before it is matched again.", "distance", "0");
+	QCommandLineOption tiledOption(QStringList() << "tiled", "Match binary PPM files too large for memory with Indexed Replace, sorting on disk.");
+	QCommandLineOption memoryOption(QStringList() << "memory", "Memory limit of --tiled in MiB.", "MiB", "1024");
+	QCommandLineOption tempOption(QStringList() << "temp", "Directory for the temporary files of --tiled.", "dir");
+	QCommandLineOption listOption(QStringList() << "l" << "list", "List techniques and distances and exit.");
+	parser.addOption(inputOption);
+	parser.addOption(paletteOption);
+	parser.addOption(outputOption);
+	parser.addOption(techniqueOption);
+	parser.addOption(distanceOption);
+	parser.addOption(iterationsOption);
+	parser.addOption(seedOption);
+	parser.addOption(errorLogOption);
+	parser.addOption(countersOption);
+	parser.addOption(traceOption);
+	parser.addOption(paletteIndexOption);
+	parser.addOption(framesOption);
+	parser.addOption(thresholdOption);
+	parser.addOption(tiledOption);
+	parser.addOption(memoryOption);
+	parser.addOption(tempOption);
+	parser.addOption(listOption);
+	parser.process(app);
+
+	auto funcs = distanceList();
+	auto algos = techniqueList();
+
+	if (parser.isSet(listOption))
+	{
+		out << "Techniques:" << endl;
+		for (int i = 0; i < algos.size(); i++)
+			out << "  " << i << ": " << algos.at(i) << endl;
+
+		out << "Distances:" << endl;
+		for (int i = 0; i < funcs.size(); i++)
+			out << "  " << i << ": " << funcs.at(i) << endl;
+
+		return 0;
+	}
+
+	if (!parser.isSet(inputOption) || !parser.isSet(paletteOption))
+	{
+		err << "Both --input and --palette are required." << endl;
+		return 1;
+	}
+
+	auto algoIndex = findByName(algos, parser.value(techniqueOption));
+	auto funcIndex = findByName(funcs, parser.value(distanceOption));
+	if (algoIndex < 0 || funcIndex < 0)
+	{
+		err << "Unknown technique or distance, see --list." << endl;
+		return 1;
+	}
+
+	Options options;
+	options.sInput = parser.value(inputOption);
+	options.sPalette = parser.value(paletteOption);
+	options.sOutput = parser.value(outputOption);
+	options.sErrorLog = parser.value(errorLogOption);
+	options.sTrace = parser.value(traceOption);
+	options.sPaletteIndex = parser.value(paletteIndexOption);
+	options.sTemp = parser.value(tempOption);
+	options.sFrames = parser.value(framesOption);
+	options.fThreshold = parser.value(thresholdOption).toDouble();
+	options.iMemory = parser.value(memoryOption).toLongLong() << 20;
+	options.iTechnique = algoIndex;
+	options.iDistance = funcIndex;
+	options.iMaxSteps = parser.value(iterationsOption).toInt();
+	options.bCounters = parser.isSet(countersOption);
+
+	if (parser.isSet(seedOption))
+		qsrand(parser.value(seedOption).toUInt());
+	else
+		qsrand(QDateTime::currentDateTime().toTime_t());
+
+	if (parser.isSet(traceOption))
+		Trace::start();
+
+	if (parser.isSet(tiledOption))
+		return runTiled(options, out, err);
+
+	if (parser.isSet(framesOption))
+		return runFrames(options, out, err);
+
+	return runSingle(options, out, err);
+}
@@ -0,0 +1,79 @@
+#include "colorcache.h"
+#include "imageview.h"
+#include "counters.h"
+#include <QHash>
+
+template <class T>
+ColorCacheT<T>::ColorCacheT()
+	: eSpace(kColorSpaceRGB)
+	, vC0()
+	, vC1()
+	, vC2()
+{
+}
+
+template <class T>
+void ColorCacheT<T>::build(const QImage *img, ColorSpace space)
+{
+	clear();
+	eSpace = space;
+
+	auto view = constImageView(img);
+	auto h = view.height();
+	auto w = view.width();
+	vC0.resize(h * w);
+	vC1.resize(h * w);
+	vC2.resize(h * w);
+	Counters::count(Counters::kCounterBytesAllocated, qint64(h) * w * 3 * sizeof(T));
+
+	// Photos repeat colors a lot, so each distinct color is converted only once.
+	QHash<unsigned int, PixelNormalizedT<T>> converted;
+
+	for (int i = 0, y = 0; y < h; y++)
+	{
+		auto line = view.row(y);
+		for (int x = 0; x < w; x++, i++)
+		{
+			auto px = Pixel(line[x]);
+			auto it = converted.find(px.c);
+			if (it == converted.end())
+				it = converted.insert(px.c, RGBtoColorSpace<T>(px, space));
+
+			vC0[i] = it->x;
+			vC1[i] = it->y;
+			vC2[i] = it->z;
+		}
+	}
+}
+
+template <class T>
+void ColorCacheT<T>::build(const QVector<Pixel> &colors, ColorSpace space)
+{
+	clear();
+	eSpace = space;
+
+	auto n = colors.size();
+	vC0.resize(n);
+	vC1.resize(n);
+	vC2.resize(n);
+	Counters::count(Counters::kCounterBytesAllocated, qint64(n) * 3 * sizeof(T));
+
+	for (int i = 0; i < n; i++)
+	{
+		auto c = RGBtoColorSpace<T>(colors[i], space);
+		vC0[i] = c.x;
+		vC1[i] = c.y;
+		vC2[i] = c.z;
+	}
+}
+
+template <class T>
+void ColorCacheT<T>::clear()
+{
+	vC0.clear();
+	vC1.clear();
+	vC2.clear();
+}
+
+template class ColorCacheT<double>;
+template class ColorCacheT<float>;
@@ -0,0 +1,74 @@
+#ifndef COLORCACHE_H
+#define COLORCACHE_H
+
+#include "pixel.h"
+#include <QVector>
+
+class QImage;
+
+// Every pixel of an image converted once to a color space, stored as one
+// array per channel in row major order (index = y * width + x). Can also
+// hold a plain list of colors, then the index is the list position. T is the
+// scalar type of the coordinates, float halves the memory the hot loops read.
+template <class T>
+class ColorCacheT
+{
+	public:
+		ColorCacheT();
+
+		// img is 32 bit, see imageview.h.
+		void build(const QImage *img, ColorSpace space);
+		void build(const QVector<Pixel> &colors, ColorSpace space);
+		void clear();
+
+		bool isEmpty() const
+		{
+			return vC0.isEmpty();
+		}
+
+		ColorSpace space() const
+		{
+			return eSpace;
+		}
+
+		int size() const
+		{
+			return vC0.size();
+		}
+
+		PixelNormalizedT<T> at(int i) const
+		{
+			PixelNormalizedT<T> n;
+			n.x = vC0[i];
+			n.y = vC1[i];
+			n.z = vC2[i];
+			return n;
+		}
+
+		// Keeps the cache in sync when a technique swaps two pixels.
+		void swap(int i, int j)
+		{
+			std::swap(vC0[i], vC0[j]);
+			std::swap(vC1[i], vC1[j]);
+			std::swap(vC2[i], vC2[j]);
+		}
+
+		const T *channel(int c) const
+		{
+			return c == 0 ? vC0.constData() : c == 1 ? vC1.constData() : vC2.constData();
+		}
+
+	private:
+		ColorSpace eSpace;
+		QVector<T> vC0;
+		QVector<T> vC1;
+		QVector<T> vC2;
+};
+
+typedef ColorCacheT<double> ColorCache;
+typedef ColorCacheT<float> ColorCacheF;
+
+extern template class ColorCacheT<double>;
+extern template class ColorCacheT<float>;
+
+#endif // COLORCACHE_H
@@ -0,0 +1,101 @@
+#include "colorhistogram.h"
+#include "imageview.h"
+#include "counters.h"
+#include <algorithm>
+
+ColorHistogram::ColorHistogram()
+	: vColors()
+	, vStart()
+	, vNext()
+	, vIndices()
+	, mLookup()
+{
+}
+
+void ColorHistogram::build(const QImage *img)
+{
+	clear();
+
+	auto view = constImageView(img);
+	auto h = view.height();
+	auto w = view.width();
+
+	// First pass finds the colors and counts them, the second one places the
+	// pixel indices of every color after the ones of the previous colors.
+	QVector<int> colorOf(h * w);
+	QVector<int> counts;
+
+	for (int i = 0, y = 0; y < h; y++)
+	{
+		auto line = view.row(y);
+		for (int x = 0; x < w; x++, i++)
+		{
+			auto px = Pixel(line[x]);
+			auto it = mLookup.find(px.c);
+			if (it == mLookup.end())
+			{
+				it = mLookup.insert(px.c, vColors.size());
+				vColors.append(px);
+				counts.append(0);
+			}
+
+			colorOf[i] = *it;
+			counts[*it]++;
+		}
+	}
+
+	auto n = vColors.size();
+	vStart.resize(n + 1);
+	vStart[0] = 0;
+	for (int c = 0; c < n; c++)
+		vStart[c + 1] = vStart[c] + counts[c];
+
+	vNext = vStart.mid(0, n);
+	vIndices.resize(h * w);
+	for (int i = 0; i < h * w; i++)
+		vIndices[vNext[colorOf[i]]++] = i;
+
+	vNext = vStart.mid(0, n);
+
+	Counters::count(Counters::kCounterBytesAllocated, qint64(h) * w * 2 * sizeof(int)
+		+ qint64(n) * (sizeof(Pixel) + 2 * sizeof(int)));
+}
+
+void ColorHistogram::assign(const Pixel *colors, int size, const int *start, const int *indices)
+{
+	clear();
+
+	auto pixels = start[size];
+	vColors.resize(size);
+	std::copy(colors, colors + size, vColors.begin());
+	vStart.resize(size + 1);
+	std::copy(start, start + size + 1, vStart.begin());
+	vIndices.resize(pixels);
+	std::copy(indices, indices + pixels, vIndices.begin());
+	vNext = vStart.mid(0, size);
+
+	mLookup.reserve(size);
+	for (int c = 0; c < size; c++)
+		mLookup.insert(vColors[c].c, c);
+
+	Counters::count(Counters::kCounterBytesAllocated, qint64(pixels) * sizeof(int)
+		+ qint64(size) * (sizeof(Pixel) + 2 * sizeof(int)));
+}
+
+void ColorHistogram::clear()
+{
+	vColors.clear();
+	vStart.clear();
+	vNext.clear();
+	vIndices.clear();
+	mLookup.clear();
+}
+
+int ColorHistogram::take(int i, int n, const int **indices)
+{
+	n = std::min(n, remaining(i));
+	*indices = vIndices.constData() + vNext[i];
+	vNext[i] += n;
+
+	return n;
+}
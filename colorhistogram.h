@@ -0,0 +1,119 @@
+#ifndef COLORHISTOGRAM_H
+#define COLORHISTOGRAM_H
+
+#include "pixel.h"
+#include <QVector>
+#include <QHash>
+
+class QImage;
+
+// Distinct colors of an image, with how many pixels use each one and which.
+// The pixel indices (y * width + x) of a color are contiguous and in row
+// major order, they are handed out front to back as pixels get matched.
+class ColorHistogram
+{
+	public:
+		ColorHistogram();
+
+		// img is 32 bit, see imageview.h.
+		void build(const QImage *img);
+
+		// The histogram build made earlier, from its colors, the size + 1
+		// offsets of their pixels and the pixel indices, see PaletteIndex.
+		void assign(const Pixel *colors, int size, const int *start, const int *indices);
+
+		void clear();
+
+		// Distinct colors.
+		int size() const
+		{
+			return vColors.size();
+		}
+
+		int pixels() const
+		{
+			return vIndices.size();
+		}
+
+		// Index of a color, or -1.
+		int find(Pixel p) const
+		{
+			return mLookup.value(p.c, -1);
+		}
+
+		Pixel color(int i) const
+		{
+			return vColors[i];
+		}
+
+		const QVector<Pixel> &colors() const
+		{
+			return vColors;
+		}
+
+		int count(int i) const
+		{
+			return vStart[i + 1] - vStart[i];
+		}
+
+		// Share of total pixels for color i, proportional to its count. The
+		// shares of all colors add up to total exactly.
+		int quota(int i, int total) const
+		{
+			auto pixels = qint64(vIndices.size());
+			return int(vStart[i + 1] * qint64(total) / pixels - vStart[i] * qint64(total) / pixels);
+		}
+
+		// All count(i) pixels of color i.
+		const int *indices(int i) const
+		{
+			return vIndices.constData() + vStart[i];
+		}
+
+		// Pixels of color i not handed out yet.
+		int remaining(int i) const
+		{
+			return vStart[i + 1] - vNext[i];
+		}
+
+		// Hands out up to n pixels of color i, returns how many and points
+		// indices at them.
+		int take(int i, int n, const int **indices);
+
+	private:
+		QVector<Pixel> vColors;
+		QVector<int> vStart;	// size() + 1 offsets into vIndices
+		QVector<int> vNext;		// first pixel of each color not handed out
+		QVector<int> vIndices;
+		QHash<unsigned int, int> mLookup;
+};
+
+// Pairs up the pixels of colors present in both histograms, which need no
+// distance at all: assign(color, inputIndices, n) is called for every run of
+// input pixels that keep their own color. Both histograms are consumed.
+template <class F>
+int matchExactColors(ColorHistogram &input, ColorHistogram &palette, F assign)
+{
+	int matched = 0;
+	for (int i = 0; i < input.size(); i++)
+	{
+		auto j = palette.find(input.color(i));
+		if (j < 0)
+			continue;
+
+		auto n = std::min(input.remaining(i), palette.remaining(j));
+		if (n <= 0)
+			continue;
+
+		const int *indices = nullptr;
+		const int *unused = nullptr;
+		input.take(i, n, &indices);
+		palette.take(j, n, &unused);
+		assign(input.color(i), indices, n);
+		matched += n;
+	}
+
+	return matched;
+}
+
+#endif // COLORHISTOGRAM_H
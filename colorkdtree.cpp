@@ -0,0 +1,264 @@
+#include "colorkdtree.h"
+#include "colorcache.h"
+#include "counters.h"
+#include <algorithm>
+#include <limits>
+
+// Undefined coordinates, like the hue of a grey, would break both the split
+// and the search, since NaN compares false to everything. They all take this
+// value instead, well outside any color space, which keeps such points
+// together and away from the defined ones, as the sort keys do with -inf.
+static const double kUndefinedCoordinate = -1e4;
+
+static inline double coordinate(double v)
+{
+	return v != v ? kUndefinedCoordinate : v;
+}
+
+ColorKdTree::ColorKdTree()
+	: vCoords()
+	, vPoint()
+	, vNode()
+	, vCount()
+	, vSubtree()
+	, vParent()
+	, vAxis()
+	, iRoot(-1)
+{
+}
+
+void ColorKdTree::build(const ColorCache &points, const QVector<int> &counts)
+{
+	clear();
+
+	vNode.fill(-1, points.size());
+	for (int i = 0; i < points.size(); i++)
+	{
+		if (counts[i] > 0)
+			vPoint.append(i);
+	}
+
+	auto n = vPoint.size();
+	vParent.resize(n);
+	vAxis.resize(n);
+	vSubtree.resize(n);
+
+	build(0, n, -1, points, counts);
+
+	// Coordinates and counts in node order, next to each other for the search.
+	vCoords.resize(n * 3);
+	vCount.resize(n);
+	for (int node = 0; node < n; node++)
+	{
+		auto i = vPoint[node];
+		auto c = points.at(i);
+		vCoords[node * 3 + 0] = coordinate(c.x);
+		vCoords[node * 3 + 1] = coordinate(c.y);
+		vCoords[node * 3 + 2] = coordinate(c.z);
+		vCount[node].store(counts[i]);
+		vNode[i] = node;
+	}
+
+	iRoot = n > 0 ? n >> 1 : -1;
+
+	Counters::count(Counters::kCounterBytesAllocated, qint64(n) * (3 * sizeof(double) + 4 * sizeof(int) + 1)
+		+ qint64(points.size()) * sizeof(int));
+}
+
+int ColorKdTree::build(int lo, int hi, int parent, const ColorCache &points, const QVector<int> &counts)
+{
+	if (lo >= hi)
+		return 0;
+
+	// split along the axis with the widest spread
+	double low[3];
+	double high[3];
+	for (int c = 0; c < 3; c++)
+	{
+		low[c] = std::numeric_limits<double>::max();
+		high[c] = std::numeric_limits<double>::lowest();
+	}
+
+	for (int i = lo; i < hi; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			auto v = coordinate(points.channel(c)[vPoint[i]]);
+			low[c] = std::min(low[c], v);
+			high[c] = std::max(high[c], v);
+		}
+	}
+
+	int axis = 0;
+	for (int c = 1; c < 3; c++)
+	{
+		if (high[c] - low[c] > high[axis] - low[axis])
+			axis = c;
+	}
+
+	auto mid = (lo + hi) >> 1;
+	auto channel = points.channel(axis);
+	std::nth_element(vPoint.begin() + lo, vPoint.begin() + mid, vPoint.begin() + hi, [channel](int a, int b)
+	{
+		return coordinate(channel[a]) < coordinate(channel[b]);
+	});
+
+	vAxis[mid] = char(axis);
+	vParent[mid] = parent;
+	auto units = counts[vPoint[mid]]
+		+ build(lo, mid, mid, points, counts)
+		+ build(mid + 1, hi, mid, points, counts);
+	vSubtree[mid].store(units);
+
+	return units;
+}
+
+void ColorKdTree::clear()
+{
+	vCoords.clear();
+	vPoint.clear();
+	vNode.clear();
+	vCount.clear();
+	vSubtree.clear();
+	vParent.clear();
+	vAxis.clear();
+	iRoot = -1;
+}
+
+int ColorKdTree::take(int i, int n)
+{
+	auto node = vNode[i];
+	if (node < 0)
+		return 0;
+
+	// the node first, the subtrees after, so a search never skips units
+	auto &count = vCount[node];
+	int left;
+	int taken;
+	do
+	{
+		left = count.load();
+		taken = std::min(n, left);
+		if (taken <= 0)
+			return 0;
+	}
+	while (!count.testAndSetRelaxed(left, left - taken));
+
+	for (auto j = node; j >= 0; j = vParent[j])
+		vSubtree[j].fetchAndAddRelaxed(-taken);
+
+	return taken;
+}
+
+int ColorKdTree::nearest(const PixelNormalized &p) const
+{
+	if (remaining() == 0)
+		return -1;
+
+	double q[3] = {coordinate(p.x), coordinate(p.y), coordinate(p.z)};
+	int best = -1;
+	int steps = 0;
+	auto bestDistance = std::numeric_limits<double>::max();
+	search(0, vPoint.size(), q, best, bestDistance, steps);
+	Counters::count(Counters::kCounterSearchSteps, steps);
+
+	return best < 0 ? -1 : vPoint[best];
+}
+
+void ColorKdTree::search(int lo, int hi, const double *q, int &best, double &bestDistance, int &steps) const
+{
+	if (lo >= hi)
+		return;
+
+	auto mid = (lo + hi) >> 1;
+	if (vSubtree[mid].load() == 0)
+		return;
+
+	steps++;
+
+	auto c = vCoords.constData() + mid * 3;
+	if (vCount[mid].load() > 0)
+	{
+		auto d = Distance(q[0], c[0]) + Distance(q[1], c[1]) + Distance(q[2], c[2]);
+		if (best < 0 || d < bestDistance)
+		{
+			bestDistance = d;
+			best = mid;
+		}
+	}
+
+	// nearer side first, the other one only if the splitting plane is closer
+	// than the best so far
+	int axis = vAxis[mid];
+	auto diff = q[axis] - c[axis];
+	if (diff < 0)
+	{
+		search(lo, mid, q, best, bestDistance, steps);
+		if (diff * diff < bestDistance)
+			search(mid + 1, hi, q, best, bestDistance, steps);
+	}
+	else
+	{
+		search(mid + 1, hi, q, best, bestDistance, steps);
+		if (diff * diff < bestDistance)
+			search(lo, mid, q, best, bestDistance, steps);
+	}
+}
+
+void ColorKdTree::nearest(const PixelNormalized &p, int k, QVector<int> &out) const
+{
+	out.clear();
+	if (remaining() == 0 || k <= 0)
+		return;
+
+	double q[3] = {coordinate(p.x), coordinate(p.y), coordinate(p.z)};
+	QVector<Candidate> heap;
+	heap.reserve(k + 1);
+	int steps = 0;
+	search(0, vPoint.size(), q, k, heap, steps);
+	Counters::count(Counters::kCounterSearchSteps, steps);
+
+	std::sort_heap(heap.begin(), heap.end());
+	for (auto &c : heap)
+		out.append(vPoint[c.second]);
+}
+
+void ColorKdTree::search(int lo, int hi, const double *q, int k, QVector<Candidate> &heap, int &steps) const
+{
+	if (lo >= hi)
+		return;
+
+	auto mid = (lo + hi) >> 1;
+	if (vSubtree[mid].load() == 0)
+		return;
+
+	steps++;
+
+	// max heap of the k best so far, the top is the one to beat
+	auto c = vCoords.constData() + mid * 3;
+	if (vCount[mid].load() > 0)
+	{
+		auto d = Distance(q[0], c[0]) + Distance(q[1], c[1]) + Distance(q[2], c[2]);
+		if (heap.size() < k || d < heap.first().first)
+		{
+			heap.append(Candidate(d, mid));
+			std::push_heap(heap.begin(), heap.end());
+			if (heap.size() > k)
+			{
+				std::pop_heap(heap.begin(), heap.end());
+				heap.removeLast();
+			}
+		}
+	}
+
+	int axis = vAxis[mid];
+	auto diff = q[axis] - c[axis];
+	auto first = diff < 0 ? lo : mid + 1;
+	auto firstEnd = diff < 0 ? mid : hi;
+	auto second = diff < 0 ? mid + 1 : lo;
+	auto secondEnd = diff < 0 ? hi : mid;
+
+	search(first, firstEnd, q, k, heap, steps);
+	if (heap.size() < k || diff * diff < heap.first().first)
+		search(second, secondEnd, q, k, heap, steps);
+}
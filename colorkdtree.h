@@ -0,0 +1,69 @@
+#ifndef COLORKDTREE_H
+#define COLORKDTREE_H
+
+#include "pixel.h"
+#include "colorcache.h"
+#include <QVector>
+#include <QAtomicInt>
+#include <utility>
+
+// Colors as points in 3-D, each with a number of units (pixels using it),
+// for nearest remaining color queries while units get consumed. Built once as
+// a balanced tree stored in an array, every node keeps how many units are left
+// in its subtree so exhausted branches are skipped without rebalancing.
+// Distances are squared euclidean in whatever space the points were given.
+// Undefined coordinates (the hue of a grey) count as one fixed value far
+// outside every space, for points and queries alike.
+//
+// Counts are atomic, so several threads may take() and search one tree at
+// once. A search can then return a point whose last units another thread
+// takes first, take() returns 0 for it and the caller searches again.
+class ColorKdTree
+{
+	public:
+		ColorKdTree();
+
+		// Point i is points.at(i) with counts[i] units, points without units
+		// are left out.
+		void build(const ColorCache &points, const QVector<int> &counts);
+		void clear();
+
+		int remaining() const
+		{
+			return iRoot < 0 ? 0 : vSubtree[iRoot].load();
+		}
+
+		// Units left of point i.
+		int count(int i) const
+		{
+			return vNode[i] < 0 ? 0 : vCount[vNode[i]].load();
+		}
+
+		// Consumes up to n units of point i, returns how many were taken.
+		int take(int i, int n = 1);
+
+		// The point with units left closest to p, or -1.
+		int nearest(const PixelNormalized &p) const;
+
+		// Up to k points with units left closest to p, nearest first.
+		void nearest(const PixelNormalized &p, int k, QVector<int> &out) const;
+
+	private:
+		int build(int lo, int hi, int parent, const ColorCache &points, const QVector<int> &counts);
+		// steps counts the nodes visited, see Counters.
+		void search(int lo, int hi, const double *q, int &best, double &bestDistance, int &steps) const;
+
+		typedef std::pair<double, int> Candidate;
+		void search(int lo, int hi, const double *q, int k, QVector<Candidate> &heap, int &steps) const;
+
+		QVector<double> vCoords;	// 3 per node
+		QVector<int> vPoint;		// point of each node
+		QVector<int> vNode;			// node of each point, -1 when left out
+		QVector<QAtomicInt> vCount;		// units of each node
+		QVector<QAtomicInt> vSubtree;	// units in the subtree of each node
+		QVector<int> vParent;
+		QVector<char> vAxis;
+		int iRoot;
+};
+
+#endif // COLORKDTREE_H
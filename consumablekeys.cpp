@@ -0,0 +1,202 @@
+#include "consumablekeys.h"
+#include "counters.h"
+#include <algorithm>
+#include <cmath>
+
+ConsumableKeys::ConsumableKeys()
+	: vKeys()
+	, vTree()
+	, vCount()
+	, iRemaining(0)
+	, iHighBit(0)
+{
+}
+
+void ConsumableKeys::reset(const QVector<double> &keys)
+{
+	reset(keys, QVector<int>(keys.size(), 1));
+}
+
+void ConsumableKeys::reset(const QVector<double> &keys, const QVector<int> &counts)
+{
+	auto n = keys.size();
+
+	vKeys = keys;
+	vCount = counts;
+	vTree.fill(0, n + 1);
+	iRemaining = 0;
+
+	// Linear build: every node starts at its count and pushes its sum to its parent.
+	for (int i = 1; i <= n; i++)
+	{
+		vTree[i] += counts[i - 1];
+		iRemaining += counts[i - 1];
+		auto parent = i + (i & -i);
+		if (parent <= n)
+			vTree[parent] += vTree[i];
+	}
+
+	iHighBit = 1;
+	while (iHighBit * 2 <= n)
+		iHighBit *= 2;
+
+	Counters::count(Counters::kCounterBytesAllocated, qint64(n) * (sizeof(double) + 2 * sizeof(int)));
+}
+
+void ConsumableKeys::clear()
+{
+	vKeys.clear();
+	vTree.clear();
+	vCount.clear();
+	iRemaining = 0;
+	iHighBit = 0;
+}
+
+int ConsumableKeys::take(int i, int n)
+{
+	n = std::min(n, vCount[i]);
+	if (n <= 0)
+		return 0;
+
+	vCount[i] -= n;
+	iRemaining -= n;
+
+	for (auto size = vKeys.size(), j = i + 1; j <= size; j += j & -j)
+		vTree[j] -= n;
+
+	return n;
+}
+
+int ConsumableKeys::countBefore(int i) const
+{
+	int sum = 0;
+	for (int j = i; j > 0; j -= j & -j)
+		sum += vTree[j];
+
+	return sum;
+}
+
+int ConsumableKeys::findKth(int k) const
+{
+	int pos = 0;
+	for (auto step = iHighBit; step > 0; step >>= 1)
+	{
+		if (pos + step < vTree.size() && vTree[pos + step] < k)
+		{
+			pos += step;
+			k -= vTree[pos];
+		}
+	}
+
+	return pos;
+}
+
+int ConsumableKeys::next(int i) const
+{
+	if (i < 0)
+		i = 0;
+
+	if (i >= vKeys.size())
+		return -1;
+
+	if (vCount[i])
+		return i;
+
+	auto k = countBefore(i) + 1;
+	return k > iRemaining ? -1 : findKth(k);
+}
+
+int ConsumableKeys::prev(int i) const
+{
+	if (i < 0)
+		return -1;
+
+	if (i >= vKeys.size())
+		i = vKeys.size() - 1;
+
+	if (vCount[i])
+		return i;
+
+	auto k = countBefore(i + 1);
+	return k == 0 ? -1 : findKth(k);
+}
+
+int ConsumableKeys::findNearest(double value) const
+{
+	if (iRemaining == 0)
+		return -1;
+
+	int i = std::lower_bound(vKeys.constBegin(), vKeys.constEnd(), value) - vKeys.constBegin();
+	auto hi = next(i);
+	auto lo = prev(i - 1);
+
+	int pick = hi;
+	if (hi < 0 || (lo >= 0 && value - vKeys[lo] <= vKeys[hi] - value))
+		pick = lo;
+
+	return pick;
+}
+
+int ConsumableKeys::findBisect(double value) const
+{
+	if (iRemaining == 0)
+		return -1;
+
+	int lower = 0;
+	int higher = iRemaining - 1;
+	int found = -1;
+	int steps = 0;
+
+	while (found < 0)
+	{
+		steps++;
+
+		if (lower == higher || higher < 0)
+		{
+			found = findKth(lower + 1);
+		}
+		else if (lower > higher)
+		{
+			// past the end, every remaining key is smaller than value
+			if (lower >= iRemaining)
+			{
+				found = findKth(iRemaining);
+			}
+			else
+			{
+				auto vh = vKeys[findKth(lower + 1)];
+				auto vl = vKeys[findKth(lower)];
+				found = std::abs(value - vh) < value - vl ? findKth(lower + 1) : findKth(lower);
+			}
+		}
+		else
+		{
+			auto mid = (higher + lower) >> 1;
+			auto k = vKeys[findKth(mid + 1)];
+
+			if (k > value)
+				higher = mid - 1;
+			else if (k < value)
+				lower = mid + 1;
+			else
+				found = findKth(mid + 1);
+		}
+	}
+
+	Counters::count(Counters::kCounterSearchSteps, steps);
+
+	return found;
+}
+
+int ConsumableKeys::findLowerBound(double value) const
+{
+	if (iRemaining == 0)
+		return -1;
+
+	int i = std::lower_bound(vKeys.constBegin(), vKeys.constEnd(), value) - vKeys.constBegin();
+	auto pick = next(i);
+	if (pick < 0)
+		pick = prev(i - 1);
+
+	return pick;
+}
@@ -0,0 +1,109 @@
+#ifndef CONSUMABLEKEYS_H
+#define CONSUMABLEKEYS_H
+
+#include <QVector>
+
+// A sorted list of keys from which the nearest remaining key can be found and
+// consumed in O(log n), instead of erasing from a QList in O(n). Keys never
+// move: a Fenwick tree counts the remaining entries, so indices stay valid
+// and can be used to look up whatever the keys were sorted from. An entry can
+// stand for several identical keys (a color used by many pixels), it is taken
+// once per unit and searches rank over units as if the keys were repeated.
+class ConsumableKeys
+{
+	public:
+		ConsumableKeys();
+
+		// keys must be sorted ascending, all entries start as remaining.
+		void reset(const QVector<double> &keys);
+		void reset(const QVector<double> &keys, const QVector<int> &counts);
+		void clear();
+
+		int size() const
+		{
+			return vKeys.size();
+		}
+
+		int remaining() const
+		{
+			return iRemaining;
+		}
+
+		double key(int i) const
+		{
+			return vKeys[i];
+		}
+
+		bool isTaken(int i) const
+		{
+			return vCount[i] == 0;
+		}
+
+		// Units left of entry i.
+		int count(int i) const
+		{
+			return vCount[i];
+		}
+
+		// Consumes up to n units of entry i, returns how many were taken.
+		int take(int i, int n = 1);
+
+		// First remaining index >= i, or -1.
+		int next(int i) const;
+
+		// Last remaining index <= i, or -1.
+		int prev(int i) const;
+
+		// The remaining key closest to value (the lower one on a tie), or -1
+		// when nothing remains.
+		int findNearest(double value) const;
+
+		// The same key the recursive bisect of the bisect techniques picked
+		// when it erased from a QList: a binary search over the remaining keys
+		// by rank, which settles on a neighbour of value without always
+		// comparing both sides. O(log^2 n), every probe is a rank lookup.
+		int findBisect(double value) const;
+
+		// The first remaining key >= value, or the last remaining one when all
+		// are smaller, or -1 when nothing remains.
+		int findLowerBound(double value) const;
+
+		// The find functions above, consuming one unit of the entry found.
+		int takeNearest(double value)
+		{
+			return takeFound(findNearest(value));
+		}
+
+		int takeBisect(double value)
+		{
+			return takeFound(findBisect(value));
+		}
+
+		int takeLowerBound(double value)
+		{
+			return takeFound(findLowerBound(value));
+		}
+
+	private:
+		// Remaining entries in [0, i).
+		int countBefore(int i) const;
+
+		// Index of the k-th remaining entry, k starting at 1.
+		int findKth(int k) const;
+
+		int takeFound(int i)
+		{
+			if (i >= 0)
+				take(i);
+
+			return i;
+		}
+
+		QVector<double> vKeys;
+		QVector<int> vTree;		// Fenwick tree, 1-based
+		QVector<int> vCount;
+		int iRemaining;
+		int iHighBit;
+};
+
+#endif // CONSUMABLEKEYS_H
@@ -0,0 +1,64 @@
+# Shared algorithm core, used by the GUI and the headless runner.
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+	$$PWD/ialgorithm.cpp \
+	$$PWD/colorcache.cpp \
+	$$PWD/errortracker.cpp \
+	$$PWD/counters.cpp \
+	$$PWD/trace.cpp \
+	$$PWD/dirtytiles.cpp \
+	$$PWD/colorhistogram.cpp \
+	$$PWD/colorkdtree.cpp \
+	$$PWD/distancebatch.cpp \
+	$$PWD/consumablekeys.cpp \
+	$$PWD/pixellist.cpp \
+	$$PWD/paletteindex.cpp \
+	$$PWD/algorithmcopy.cpp \
+	$$PWD/algorithmsort.cpp \
+	$$PWD/algorithmswap.cpp \
+	$$PWD/algorithmhistogram.cpp \
+	$$PWD/algorithmnearest.cpp \
+	$$PWD/algorithmauction.cpp \
+	$$PWD/algorithmregistry.cpp \
+	$$PWD/algorithmrunner.cpp \
+	$$PWD/framesequence.cpp \
+	$$PWD/ppmfile.cpp \
+	$$PWD/tiledmatch.cpp
+
+HEADERS += \
+	$$PWD/ialgorithm.h \
+	$$PWD/colorcache.h \
+	$$PWD/imageview.h \
+	$$PWD/errortracker.h \
+	$$PWD/counters.h \
+	$$PWD/trace.h \
+	$$PWD/dirtytiles.h \
+	$$PWD/colorhistogram.h \
+	$$PWD/colorkdtree.h \
+	$$PWD/distancebatch.h \
+	$$PWD/consumablekeys.h \
+	$$PWD/radixsort.h \
+	$$PWD/pixellist.h \
+	$$PWD/paletteindex.h \
+	$$PWD/fastrandom.h \
+	$$PWD/algorithmcopy.h \
+	$$PWD/pixel.h \
+	$$PWD/metric.h \
+	$$PWD/algorithmsort.h \
+	$$PWD/algorithmswap.h \
+	$$PWD/algorithmhistogram.h \
+	$$PWD/algorithmnearest.h \
+	$$PWD/algorithmauction.h \
+	$$PWD/algorithmregistry.h \
+	$$PWD/algorithmrunner.h \
+	$$PWD/framesequence.h \
+	$$PWD/ppmfile.h \
+	$$PWD/tiledmatch.h
@@ -0,0 +1,141 @@
+#include "counters.h"
+#include <QMutexLocker>
+
+static thread_local CounterScope *tScope = nullptr;
+
+static const char *const kCounterNames[Counters::kCounterCount] =
+{
+	"distances",
+	"swapsProposed",
+	"swapsAccepted",
+	"searchSteps",
+	"bytesAllocated"
+};
+
+static const char *const kPhaseNames[Counters::kPhaseCount] =
+{
+	"setup",
+	"sort",
+	"match",
+	"write"
+};
+
+Counters::Values::Values()
+{
+	for (int i = 0; i < kCounterCount; i++)
+		vCount[i] = 0;
+
+	for (int i = 0; i < kPhaseCount; i++)
+		vNanoseconds[i] = 0;
+}
+
+void Counters::Values::merge(const Values &other)
+{
+	for (int i = 0; i < kCounterCount; i++)
+		vCount[i] += other.vCount[i];
+
+	for (int i = 0; i < kPhaseCount; i++)
+		vNanoseconds[i] += other.vNanoseconds[i];
+}
+
+Counters::Counters()
+	: mValues()
+	, mLock()
+{
+}
+
+void Counters::reset()
+{
+	QMutexLocker lock(&mLock);
+	mValues = Values();
+}
+
+void Counters::merge(const Values &values)
+{
+	QMutexLocker lock(&mLock);
+	mValues.merge(values);
+}
+
+void Counters::addTime(Phase phase, qint64 nanoseconds)
+{
+	QMutexLocker lock(&mLock);
+	mValues.vNanoseconds[phase] += nanoseconds;
+}
+
+Counters::Values Counters::values() const
+{
+	QMutexLocker lock(&mLock);
+	return mValues;
+}
+
+QJsonObject Counters::toJson() const
+{
+	auto v = values();
+
+	QJsonObject counts;
+	for (int i = 0; i < kCounterCount; i++)
+		counts.insert(kCounterNames[i], double(v.vCount[i]));
+
+	QJsonObject times;
+	for (int i = 0; i < kPhaseCount; i++)
+		times.insert(kPhaseNames[i], v.vNanoseconds[i] / 1000000.0);
+
+	QJsonObject json;
+	json.insert("counters", counts);
+	json.insert("ms", times);
+	return json;
+}
+
+void Counters::count(Counter counter, qint64 n)
+{
+	if (tScope)
+		tScope->mValues.vCount[counter] += n;
+}
+
+CounterScope::CounterScope(Counters &target, Counters::Phase phase)
+	: pTarget(&target)
+	, pTargetValues(nullptr)
+	, mValues()
+	, pParent(tScope)
+	, mTimer()
+	, iNested(0)
+	, ePhase(phase)
+{
+	tScope = this;
+	mTimer.start();
+}
+
+CounterScope::CounterScope(Counters::Values &target)
+	: pTarget(nullptr)
+	, pTargetValues(&target)
+	, mValues()
+	, pParent(tScope)
+	, mTimer()
+	, iNested(0)
+	, ePhase(Counters::kPhaseNone)
+{
+	tScope = this;
+}
+
+CounterScope::~CounterScope()
+{
+	tScope = pParent;
+
+	if (pTargetValues)
+	{
+		pTargetValues->merge(mValues);
+		return;
+	}
+
+	if (ePhase != Counters::kPhaseNone)
+	{
+		auto elapsed = mTimer.nsecsElapsed();
+		mValues.vNanoseconds[ePhase] += elapsed - iNested;
+
+		// only time spent in a phase of the same run is taken out of the parent
+		if (pParent && pParent->pTarget == pTarget)
+			pParent->iNested += elapsed;
+	}
+
+	pTarget->merge(mValues);
+}
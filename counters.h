@@ -0,0 +1,90 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// What the hot paths of one technique run did, and where its time went.
+//
+// Hot paths call Counters::count(), which adds to a block owned by the
+// innermost CounterScope of the calling thread and does nothing outside of
+// one. Every worker opens its own scope, so threads never share a counter
+// while they run and the blocks are merged once when the scopes end.
+class Counters
+{
+	public:
+		enum Counter
+		{
+			kCounterDistances,		// distance formula evaluations
+			kCounterSwapsProposed,
+			kCounterSwapsAccepted,
+			kCounterSearchSteps,	// probes of key searches, nodes of tree searches
+			kCounterBytesAllocated,	// main buffers: images, caches, lists, trees
+			kCounterCount
+		};
+
+		// Time is exclusive, a phase nested in another one is only its own.
+		enum Phase
+		{
+			kPhaseSetup,
+			kPhaseSort,		// sort keys, sorted lists and histograms
+			kPhaseMatch,	// update slices, plus the time of each background worker
+			kPhaseWrite,	// saving the result, timed by the caller
+			kPhaseCount,
+			kPhaseNone = kPhaseCount
+		};
+
+		struct Values
+		{
+			Values();
+			void merge(const Values &other);
+
+			qint64 vCount[kCounterCount];
+			qint64 vNanoseconds[kPhaseCount];
+		};
+
+		Counters();
+
+		void reset();
+		void merge(const Values &values);
+		void addTime(Phase phase, qint64 nanoseconds);
+		Values values() const;
+
+		// {"counters": {...}, "ms": {...}} with camel case names.
+		QJsonObject toJson() const;
+
+		static void count(Counter counter, qint64 n = 1);
+
+	private:
+		Values mValues;
+		mutable QMutex mLock;
+};
+
+// Collects the counts of the calling thread while it lives, then merges them
+// into target, adding the time spent in it (minus nested scopes) to phase.
+class CounterScope
+{
+	public:
+		explicit CounterScope(Counters &target, Counters::Phase phase = Counters::kPhaseNone);
+
+		// Untimed and merged without a lock, for parallel work items that
+		// keep counts of their own and get summed by their owner afterwards.
+		explicit CounterScope(Counters::Values &target);
+
+		~CounterScope();
+
+	private:
+		friend class Counters;
+
+		Counters *pTarget;
+		Counters::Values *pTargetValues;
+		Counters::Values mValues;
+		CounterScope *pParent;
+		QElapsedTimer mTimer;
+		qint64 iNested;
+		Counters::Phase ePhase;
+};
+
+#endif // COUNTERS_H
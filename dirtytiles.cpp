@@ -0,0 +1,53 @@
+#include "dirtytiles.h"
+
+DirtyTiles::DirtyTiles()
+	: vTiles()
+	, iWidth(0)
+	, iHeight(0)
+	, iColumns(0)
+	, iRows(0)
+{
+}
+
+void DirtyTiles::reset(int width, int height)
+{
+	iWidth = width;
+	iHeight = height;
+	iColumns = (width + kTileSize - 1) >> kTileShift;
+	iRows = (height + kTileSize - 1) >> kTileShift;
+
+	vTiles.resize(iColumns * iRows);
+	markAll();
+}
+
+void DirtyTiles::clear()
+{
+	vTiles.clear();
+	iWidth = iHeight = iColumns = iRows = 0;
+}
+
+void DirtyTiles::markAll()
+{
+	for (auto &tile : vTiles)
+		tile.storeRelease(1);
+}
+
+QVector<QRect> DirtyTiles::take()
+{
+	QVector<QRect> rects;
+
+	for (int row = 0; row < iRows; row++)
+	{
+		for (int column = 0; column < iColumns; column++)
+		{
+			auto &tile = vTiles[row * iColumns + column];
+			if (!tile.load() || !tile.fetchAndStoreAcquire(0))
+				continue;
+
+			QRect rect(column << kTileShift, row << kTileShift, kTileSize, kTileSize);
+			rects.append(rect.intersected(QRect(0, 0, iWidth, iHeight)));
+		}
+	}
+
+	return rects;
+}
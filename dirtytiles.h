@@ -0,0 +1,51 @@
+#ifndef DIRTYTILES_H
+#define DIRTYTILES_H
+
+#include <QVector>
+#include <QRect>
+#include <QAtomicInt>
+
+// Which 64x64 tiles of the result changed since the last take(), so a view
+// of it only redraws those. Any thread may mark while another one takes: a
+// tile marked during a take() is either in its list or in the next one.
+class DirtyTiles
+{
+	public:
+		static const int kTileShift = 6;
+		static const int kTileSize = 1 << kTileShift;
+
+		DirtyTiles();
+
+		// Tiles of a width x height image, all of them dirty.
+		void reset(int width, int height);
+		void clear();
+
+		void markAll();
+
+		void mark(int x, int y)
+		{
+			auto &tile = vTiles[(y >> kTileShift) * iColumns + (x >> kTileShift)];
+
+			// most writes hit a tile already marked, reading keeps its line shared
+			if (!tile.load())
+				tile.storeRelease(1);
+		}
+
+		// Pixel i in row major order.
+		void mark(int i)
+		{
+			mark(i % iWidth, i / iWidth);
+		}
+
+		// Pixel rects of the tiles marked since the last call, unmarking them.
+		QVector<QRect> take();
+
+	private:
+		QVector<QAtomicInt> vTiles;
+		int iWidth;
+		int iHeight;
+		int iColumns;
+		int iRows;
+};
+
+#endif // DIRTYTILES_H
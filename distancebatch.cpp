@@ -0,0 +1,612 @@
+#include "distancebatch.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RTP_SIMD_X86 1
+#define RTP_TARGET(t) __attribute__((target(t)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define RTP_SIMD_X86 1
+#define RTP_TARGET(t)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+// Same constants and evaluation order as rtm_distance and cmetric, so every
+// lane rounds exactly like the scalar version.
+static const double kRtmF0 = 0.114;
+static const double kRtmF1 = 0.587;
+static const double kRtmF2 = 0.299;
+static const double kRtmWeight = 10;
+
+// And as rtm_distance<float>, for the float forms.
+static const float kRtmF0f = float(0.114);
+static const float kRtmF1f = float(0.587);
+static const float kRtmF2f = float(0.299);
+static const float kRtmWeightf = 10;
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(RTP_SIMD_X86) && !defined(_MSC_VER)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return kSimdAVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return kSimdSSE4;
+#elif defined(RTP_SIMD_X86)
+	int info[4];
+	__cpuid(info, 0);
+	auto maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))
+			return kSimdAVX2;
+	}
+
+	if (sse41)
+		return kSimdSSE4;
+#endif
+	return kSimdScalar;
+}
+
+static SimdLevel gSupported = detectSimdLevel();
+static SimdLevel gLevel = gSupported;
+
+SimdLevel simdLevel()
+{
+	return gLevel;
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+		case kSimdAVX2: return "avx2";
+		case kSimdSSE4: return "sse4.1";
+		default: return "scalar";
+	}
+}
+
+void setSimdLevel(SimdLevel level)
+{
+	gLevel = std::min(level, gSupported);
+}
+
+//
+// Scalar
+//
+
+static inline double rtmLane(double x0, double x1, double x2, unsigned int c)
+{
+	double y0 = (c & 0xff) * kRtmF0;
+	double y1 = ((c >> 8) & 0xff) * kRtmF1;
+	double y2 = ((c >> 16) & 0xff) * kRtmF2;
+	double d0 = x0 - y0;
+	double d1 = x1 - y1;
+	double d2 = x2 - y2;
+	double l = (x0 + x1 + x2) - (y0 + y1 + y2);
+	return (d0 * d0 + d1 * d1 + d2 * d2) + l * l * kRtmWeight;
+}
+
+static void rtmBatchScalar(Pixel p, const Pixel *others, double *out, int n)
+{
+	double x0 = p.r * kRtmF0;
+	double x1 = p.g * kRtmF1;
+	double x2 = p.b * kRtmF2;
+	for (int i = 0; i < n; i++)
+		out[i] = rtmLane(x0, x1, x2, others[i].c);
+}
+
+static void rtmPairsScalar(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = rtm_distance(a[i], b[i]);
+}
+
+static void cmetricBatchScalar(Pixel p, const Pixel *others, double *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = cmetric(p, others[i]);
+}
+
+static void cmetricPairsScalar(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = cmetric(a[i], b[i]);
+}
+
+static void cie1976BatchScalar(const PixelNormalized &p, const double *L, const double *A, const double *B, double *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = Distance(p.L, L[i]) + Distance(p.a, A[i]) + Distance(p.b, B[i]);
+}
+
+static inline float rtmLaneFloat(float x0, float x1, float x2, unsigned int c)
+{
+	float y0 = (c & 0xff) * kRtmF0f;
+	float y1 = ((c >> 8) & 0xff) * kRtmF1f;
+	float y2 = ((c >> 16) & 0xff) * kRtmF2f;
+	float d0 = x0 - y0;
+	float d1 = x1 - y1;
+	float d2 = x2 - y2;
+	float l = (x0 + x1 + x2) - (y0 + y1 + y2);
+	return (d0 * d0 + d1 * d1 + d2 * d2) + l * l * kRtmWeightf;
+}
+
+static void rtmBatchFloatScalar(Pixel p, const Pixel *others, double *out, int n)
+{
+	float x0 = p.r * kRtmF0f;
+	float x1 = p.g * kRtmF1f;
+	float x2 = p.b * kRtmF2f;
+	for (int i = 0; i < n; i++)
+		out[i] = rtmLaneFloat(x0, x1, x2, others[i].c);
+}
+
+static void cie1976BatchFloatScalar(const PixelNormalizedF &p, const float *L, const float *A, const float *B, double *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = Distance(p.L, L[i]) + Distance(p.a, A[i]) + Distance(p.b, B[i]);
+}
+
+#if defined(RTP_SIMD_X86)
+
+//
+// SSE4.1, 2 doubles or 4 ints per lane group
+//
+
+RTP_TARGET("sse4.1")
+static inline __m128i cmetricSSE4(__m128i c1, __m128i c2)
+{
+	auto mask = _mm_set1_epi32(0xff);
+	auto r1 = _mm_and_si128(c1, mask);
+	auto g1 = _mm_and_si128(_mm_srli_epi32(c1, 8), mask);
+	auto b1 = _mm_and_si128(_mm_srli_epi32(c1, 16), mask);
+	auto r2 = _mm_and_si128(c2, mask);
+	auto g2 = _mm_and_si128(_mm_srli_epi32(c2, 8), mask);
+	auto b2 = _mm_and_si128(_mm_srli_epi32(c2, 16), mask);
+
+	auto rmean = _mm_srli_epi32(_mm_add_epi32(r1, r2), 1);
+	auto r = _mm_sub_epi32(r1, r2);
+	auto g = _mm_sub_epi32(g1, g2);
+	auto b = _mm_sub_epi32(b1, b2);
+
+	auto tr = _mm_srai_epi32(_mm_mullo_epi32(_mm_add_epi32(_mm_set1_epi32(512), rmean), _mm_mullo_epi32(r, r)), 8);
+	auto tg = _mm_slli_epi32(_mm_mullo_epi32(g, g), 2);
+	auto tb = _mm_srai_epi32(_mm_mullo_epi32(_mm_sub_epi32(_mm_set1_epi32(767), rmean), _mm_mullo_epi32(b, b)), 8);
+
+	return _mm_add_epi32(_mm_add_epi32(tr, tg), tb);
+}
+
+RTP_TARGET("sse4.1")
+static inline void storeIntsSSE4(double *out, __m128i v)
+{
+	_mm_storeu_pd(out, _mm_cvtepi32_pd(v));
+	_mm_storeu_pd(out + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+RTP_TARGET("sse4.1")
+static void cmetricBatchSSE4(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto c1 = _mm_set1_epi32(int(p.c));
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		storeIntsSSE4(out + i, cmetricSSE4(c1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(others + i))));
+
+	cmetricBatchScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("sse4.1")
+static void cmetricPairsSSE4(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		auto c1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		auto c2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		storeIntsSSE4(out + i, cmetricSSE4(c1, c2));
+	}
+
+	cmetricPairsScalar(a + i, b + i, out + i, n - i);
+}
+
+// Two pixels from the low 64 bits of c, as doubles per channel.
+RTP_TARGET("sse4.1")
+static inline void channelsSSE4(__m128i c, __m128d &r, __m128d &g, __m128d &b)
+{
+	auto mask = _mm_set1_epi32(0xff);
+	r = _mm_mul_pd(_mm_cvtepi32_pd(_mm_and_si128(c, mask)), _mm_set1_pd(kRtmF0));
+	g = _mm_mul_pd(_mm_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c, 8), mask)), _mm_set1_pd(kRtmF1));
+	b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c, 16), mask)), _mm_set1_pd(kRtmF2));
+}
+
+RTP_TARGET("sse4.1")
+static inline __m128d rtmSSE4(__m128d x0, __m128d x1, __m128d x2, __m128d y0, __m128d y1, __m128d y2)
+{
+	auto d0 = _mm_sub_pd(x0, y0);
+	auto d1 = _mm_sub_pd(x1, y1);
+	auto d2 = _mm_sub_pd(x2, y2);
+	auto t = _mm_add_pd(_mm_add_pd(_mm_mul_pd(d0, d0), _mm_mul_pd(d1, d1)), _mm_mul_pd(d2, d2));
+	auto l = _mm_sub_pd(_mm_add_pd(_mm_add_pd(x0, x1), x2), _mm_add_pd(_mm_add_pd(y0, y1), y2));
+	return _mm_add_pd(t, _mm_mul_pd(_mm_mul_pd(l, l), _mm_set1_pd(kRtmWeight)));
+}
+
+RTP_TARGET("sse4.1")
+static void rtmBatchSSE4(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto x0 = _mm_set1_pd(p.r * kRtmF0);
+	auto x1 = _mm_set1_pd(p.g * kRtmF1);
+	auto x2 = _mm_set1_pd(p.b * kRtmF2);
+
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d y0, y1, y2;
+		channelsSSE4(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(others + i)), y0, y1, y2);
+		_mm_storeu_pd(out + i, rtmSSE4(x0, x1, x2, y0, y1, y2));
+	}
+
+	rtmBatchScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("sse4.1")
+static void rtmPairsSSE4(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d x0, x1, x2, y0, y1, y2;
+		channelsSSE4(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i)), x0, x1, x2);
+		channelsSSE4(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i)), y0, y1, y2);
+		_mm_storeu_pd(out + i, rtmSSE4(x0, x1, x2, y0, y1, y2));
+	}
+
+	rtmPairsScalar(a + i, b + i, out + i, n - i);
+}
+
+RTP_TARGET("sse4.1")
+static void cie1976BatchSSE4(const PixelNormalized &p, const double *L, const double *A, const double *B, double *out, int n)
+{
+	auto pL = _mm_set1_pd(p.L);
+	auto pA = _mm_set1_pd(p.a);
+	auto pB = _mm_set1_pd(p.b);
+
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		auto dL = _mm_sub_pd(pL, _mm_loadu_pd(L + i));
+		auto dA = _mm_sub_pd(pA, _mm_loadu_pd(A + i));
+		auto dB = _mm_sub_pd(pB, _mm_loadu_pd(B + i));
+		auto d = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dL, dL), _mm_mul_pd(dA, dA)), _mm_mul_pd(dB, dB));
+		_mm_storeu_pd(out + i, d);
+	}
+
+	cie1976BatchScalar(p, L + i, A + i, B + i, out + i, n - i);
+}
+
+// Float forms, 4 floats per lane group, widened to double on the way out.
+RTP_TARGET("sse4.1")
+static inline void storeFloatsSSE4(double *out, __m128 v)
+{
+	_mm_storeu_pd(out, _mm_cvtps_pd(v));
+	_mm_storeu_pd(out + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+
+RTP_TARGET("sse4.1")
+static void rtmBatchFloatSSE4(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto x0 = _mm_set1_ps(p.r * kRtmF0f);
+	auto x1 = _mm_set1_ps(p.g * kRtmF1f);
+	auto x2 = _mm_set1_ps(p.b * kRtmF2f);
+	auto mask = _mm_set1_epi32(0xff);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(others + i));
+		auto y0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(c, mask)), _mm_set1_ps(kRtmF0f));
+		auto y1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), mask)), _mm_set1_ps(kRtmF1f));
+		auto y2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), mask)), _mm_set1_ps(kRtmF2f));
+		auto d0 = _mm_sub_ps(x0, y0);
+		auto d1 = _mm_sub_ps(x1, y1);
+		auto d2 = _mm_sub_ps(x2, y2);
+		auto t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+		auto l = _mm_sub_ps(_mm_add_ps(_mm_add_ps(x0, x1), x2), _mm_add_ps(_mm_add_ps(y0, y1), y2));
+		storeFloatsSSE4(out + i, _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(l, l), _mm_set1_ps(kRtmWeightf))));
+	}
+
+	rtmBatchFloatScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("sse4.1")
+static void cie1976BatchFloatSSE4(const PixelNormalizedF &p, const float *L, const float *A, const float *B, double *out, int n)
+{
+	auto pL = _mm_set1_ps(p.L);
+	auto pA = _mm_set1_ps(p.a);
+	auto pB = _mm_set1_ps(p.b);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		auto dL = _mm_sub_ps(pL, _mm_loadu_ps(L + i));
+		auto dA = _mm_sub_ps(pA, _mm_loadu_ps(A + i));
+		auto dB = _mm_sub_ps(pB, _mm_loadu_ps(B + i));
+		storeFloatsSSE4(out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dL, dL), _mm_mul_ps(dA, dA)), _mm_mul_ps(dB, dB)));
+	}
+
+	cie1976BatchFloatScalar(p, L + i, A + i, B + i, out + i, n - i);
+}
+
+//
+// AVX2, 4 doubles or 8 ints per lane group
+//
+
+RTP_TARGET("avx2")
+static inline __m256i cmetricAVX2(__m256i c1, __m256i c2)
+{
+	auto mask = _mm256_set1_epi32(0xff);
+	auto r1 = _mm256_and_si256(c1, mask);
+	auto g1 = _mm256_and_si256(_mm256_srli_epi32(c1, 8), mask);
+	auto b1 = _mm256_and_si256(_mm256_srli_epi32(c1, 16), mask);
+	auto r2 = _mm256_and_si256(c2, mask);
+	auto g2 = _mm256_and_si256(_mm256_srli_epi32(c2, 8), mask);
+	auto b2 = _mm256_and_si256(_mm256_srli_epi32(c2, 16), mask);
+
+	auto rmean = _mm256_srli_epi32(_mm256_add_epi32(r1, r2), 1);
+	auto r = _mm256_sub_epi32(r1, r2);
+	auto g = _mm256_sub_epi32(g1, g2);
+	auto b = _mm256_sub_epi32(b1, b2);
+
+	auto tr = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(512), rmean), _mm256_mullo_epi32(r, r)), 8);
+	auto tg = _mm256_slli_epi32(_mm256_mullo_epi32(g, g), 2);
+	auto tb = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(_mm256_set1_epi32(767), rmean), _mm256_mullo_epi32(b, b)), 8);
+
+	return _mm256_add_epi32(_mm256_add_epi32(tr, tg), tb);
+}
+
+RTP_TARGET("avx2")
+static inline void storeIntsAVX2(double *out, __m256i v)
+{
+	_mm256_storeu_pd(out, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+	_mm256_storeu_pd(out + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+}
+
+RTP_TARGET("avx2")
+static void cmetricBatchAVX2(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto c1 = _mm256_set1_epi32(int(p.c));
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		storeIntsAVX2(out + i, cmetricAVX2(c1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others + i))));
+
+	cmetricBatchScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("avx2")
+static void cmetricPairsAVX2(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		auto c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		auto c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		storeIntsAVX2(out + i, cmetricAVX2(c1, c2));
+	}
+
+	cmetricPairsScalar(a + i, b + i, out + i, n - i);
+}
+
+// Four pixels as doubles per channel, already weighted.
+RTP_TARGET("avx2")
+static inline void channelsAVX2(__m128i c, __m256d &r, __m256d &g, __m256d &b)
+{
+	auto mask = _mm_set1_epi32(0xff);
+	r = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_and_si128(c, mask)), _mm256_set1_pd(kRtmF0));
+	g = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c, 8), mask)), _mm256_set1_pd(kRtmF1));
+	b = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_and_si128(_mm_srli_epi32(c, 16), mask)), _mm256_set1_pd(kRtmF2));
+}
+
+RTP_TARGET("avx2")
+static inline __m256d rtmAVX2(__m256d x0, __m256d x1, __m256d x2, __m256d y0, __m256d y1, __m256d y2)
+{
+	auto d0 = _mm256_sub_pd(x0, y0);
+	auto d1 = _mm256_sub_pd(x1, y1);
+	auto d2 = _mm256_sub_pd(x2, y2);
+	auto t = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(d0, d0), _mm256_mul_pd(d1, d1)), _mm256_mul_pd(d2, d2));
+	auto l = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(x0, x1), x2), _mm256_add_pd(_mm256_add_pd(y0, y1), y2));
+	return _mm256_add_pd(t, _mm256_mul_pd(_mm256_mul_pd(l, l), _mm256_set1_pd(kRtmWeight)));
+}
+
+RTP_TARGET("avx2")
+static void rtmBatchAVX2(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto x0 = _mm256_set1_pd(p.r * kRtmF0);
+	auto x1 = _mm256_set1_pd(p.g * kRtmF1);
+	auto x2 = _mm256_set1_pd(p.b * kRtmF2);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d y0, y1, y2;
+		channelsAVX2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(others + i)), y0, y1, y2);
+		_mm256_storeu_pd(out + i, rtmAVX2(x0, x1, x2, y0, y1, y2));
+	}
+
+	rtmBatchScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("avx2")
+static void rtmPairsAVX2(const Pixel *a, const Pixel *b, double *out, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d x0, x1, x2, y0, y1, y2;
+		channelsAVX2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)), x0, x1, x2);
+		channelsAVX2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)), y0, y1, y2);
+		_mm256_storeu_pd(out + i, rtmAVX2(x0, x1, x2, y0, y1, y2));
+	}
+
+	rtmPairsScalar(a + i, b + i, out + i, n - i);
+}
+
+RTP_TARGET("avx2")
+static void cie1976BatchAVX2(const PixelNormalized &p, const double *L, const double *A, const double *B, double *out, int n)
+{
+	auto pL = _mm256_set1_pd(p.L);
+	auto pA = _mm256_set1_pd(p.a);
+	auto pB = _mm256_set1_pd(p.b);
+
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		auto dL = _mm256_sub_pd(pL, _mm256_loadu_pd(L + i));
+		auto dA = _mm256_sub_pd(pA, _mm256_loadu_pd(A + i));
+		auto dB = _mm256_sub_pd(pB, _mm256_loadu_pd(B + i));
+		auto d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dL, dL), _mm256_mul_pd(dA, dA)), _mm256_mul_pd(dB, dB));
+		_mm256_storeu_pd(out + i, d);
+	}
+
+	cie1976BatchScalar(p, L + i, A + i, B + i, out + i, n - i);
+}
+
+// Float forms, 8 floats per lane group.
+RTP_TARGET("avx2")
+static inline void storeFloatsAVX2(double *out, __m256 v)
+{
+	_mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+	_mm256_storeu_pd(out + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+RTP_TARGET("avx2")
+static void rtmBatchFloatAVX2(Pixel p, const Pixel *others, double *out, int n)
+{
+	auto x0 = _mm256_set1_ps(p.r * kRtmF0f);
+	auto x1 = _mm256_set1_ps(p.g * kRtmF1f);
+	auto x2 = _mm256_set1_ps(p.b * kRtmF2f);
+	auto mask = _mm256_set1_epi32(0xff);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others + i));
+		auto y0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c, mask)), _mm256_set1_ps(kRtmF0f));
+		auto y1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 8), mask)), _mm256_set1_ps(kRtmF1f));
+		auto y2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 16), mask)), _mm256_set1_ps(kRtmF2f));
+		auto d0 = _mm256_sub_ps(x0, y0);
+		auto d1 = _mm256_sub_ps(x1, y1);
+		auto d2 = _mm256_sub_ps(x2, y2);
+		auto t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d0, d0), _mm256_mul_ps(d1, d1)), _mm256_mul_ps(d2, d2));
+		auto l = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(x0, x1), x2), _mm256_add_ps(_mm256_add_ps(y0, y1), y2));
+		storeFloatsAVX2(out + i, _mm256_add_ps(t, _mm256_mul_ps(_mm256_mul_ps(l, l), _mm256_set1_ps(kRtmWeightf))));
+	}
+
+	rtmBatchFloatScalar(p, others + i, out + i, n - i);
+}
+
+RTP_TARGET("avx2")
+static void cie1976BatchFloatAVX2(const PixelNormalizedF &p, const float *L, const float *A, const float *B, double *out, int n)
+{
+	auto pL = _mm256_set1_ps(p.L);
+	auto pA = _mm256_set1_ps(p.a);
+	auto pB = _mm256_set1_ps(p.b);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		auto dL = _mm256_sub_ps(pL, _mm256_loadu_ps(L + i));
+		auto dA = _mm256_sub_ps(pA, _mm256_loadu_ps(A + i));
+		auto dB = _mm256_sub_ps(pB, _mm256_loadu_ps(B + i));
+		storeFloatsAVX2(out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dL, dL), _mm256_mul_ps(dA, dA)), _mm256_mul_ps(dB, dB)));
+	}
+
+	cie1976BatchFloatScalar(p, L + i, A + i, B + i, out + i, n - i);
+}
+
+#endif // RTP_SIMD_X86
+
+//
+// Dispatch
+//
+
+void rtm_distance_batch(Pixel p, const Pixel *others, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return rtmBatchAVX2(p, others, out, n);
+	if (gLevel == kSimdSSE4)
+		return rtmBatchSSE4(p, others, out, n);
+#endif
+	rtmBatchScalar(p, others, out, n);
+}
+
+void cmetric_batch(Pixel p, const Pixel *others, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return cmetricBatchAVX2(p, others, out, n);
+	if (gLevel == kSimdSSE4)
+		return cmetricBatchSSE4(p, others, out, n);
+#endif
+	cmetricBatchScalar(p, others, out, n);
+}
+
+void rtm_distance_pairs(const Pixel *a, const Pixel *b, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return rtmPairsAVX2(a, b, out, n);
+	if (gLevel == kSimdSSE4)
+		return rtmPairsSSE4(a, b, out, n);
+#endif
+	rtmPairsScalar(a, b, out, n);
+}
+
+void cmetric_pairs(const Pixel *a, const Pixel *b, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return cmetricPairsAVX2(a, b, out, n);
+	if (gLevel == kSimdSSE4)
+		return cmetricPairsSSE4(a, b, out, n);
+#endif
+	cmetricPairsScalar(a, b, out, n);
+}
+
+void cie1976_batch(const PixelNormalized &p, const double *L, const double *A, const double *B, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return cie1976BatchAVX2(p, L, A, B, out, n);
+	if (gLevel == kSimdSSE4)
+		return cie1976BatchSSE4(p, L, A, B, out, n);
+#endif
+	cie1976BatchScalar(p, L, A, B, out, n);
+}
+
+void rtm_distance_batch_float(Pixel p, const Pixel *others, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return rtmBatchFloatAVX2(p, others, out, n);
+	if (gLevel == kSimdSSE4)
+		return rtmBatchFloatSSE4(p, others, out, n);
+#endif
+	rtmBatchFloatScalar(p, others, out, n);
+}
+
+void cie1976_batch(const PixelNormalizedF &p, const float *L, const float *A, const float *B, double *out, int n)
+{
+#if defined(RTP_SIMD_X86)
+	if (gLevel == kSimdAVX2)
+		return cie1976BatchFloatAVX2(p, L, A, B, out, n);
+	if (gLevel == kSimdSSE4)
+		return cie1976BatchFloatSSE4(p, L, A, B, out, n);
+#endif
+	cie1976BatchFloatScalar(p, L, A, B, out, n);
+}
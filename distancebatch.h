@@ -0,0 +1,40 @@
+#ifndef DISTANCEBATCH_H
+#define DISTANCEBATCH_H
+
+#include "pixel.h"
+
+// Batch forms of the pixel.h distances over contiguous arrays. Every lane
+// follows the scalar evaluation order, so results match calling the scalar
+// function once per element (unless the whole build enables FMA contraction).
+// The AVX2 or SSE4.1 path is picked at runtime with a scalar fallback.
+
+enum SimdLevel
+{
+	kSimdScalar,
+	kSimdSSE4,
+	kSimdAVX2
+};
+
+SimdLevel simdLevel();
+const char *simdLevelName(SimdLevel level);
+
+// Forces a lower level, for benchmarks and tests. Higher than supported is clamped.
+void setSimdLevel(SimdLevel level);
+
+// out[i] = distance(p, others[i])
+void rtm_distance_batch(Pixel p, const Pixel *others, double *out, int n);
+void cmetric_batch(Pixel p, const Pixel *others, double *out, int n);
+
+// Same as rtm_distance<float>, twice the lanes of the double form.
+void rtm_distance_batch_float(Pixel p, const Pixel *others, double *out, int n);
+
+// out[i] = distance(a[i], b[i])
+void rtm_distance_pairs(const Pixel *a, const Pixel *b, double *out, int n);
+void cmetric_pairs(const Pixel *a, const Pixel *b, double *out, int n);
+
+// Lab coordinates as separate channel arrays, see ColorCache::channel.
+// out[i] = cie1976_lab(p, {L[i], A[i], B[i]})
+void cie1976_batch(const PixelNormalized &p, const double *L, const double *A, const double *B, double *out, int n);
+void cie1976_batch(const PixelNormalizedF &p, const float *L, const float *A, const float *B, double *out, int n);
+
+#endif // DISTANCEBATCH_H
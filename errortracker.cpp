@@ -0,0 +1,134 @@
+#include "errortracker.h"
+#include "counters.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+// Undefined distances, like the hue of a grey, count as a match.
+static float clean(double d)
+{
+	return d > 0 ? float(d) : 0.f;
+}
+
+ErrorTracker::Changes::Changes()
+	: fTotal(0)
+{
+	for (int i = 0; i < kBins; i++)
+		vBins[i] = 0;
+}
+
+ErrorTracker::ErrorTracker()
+	: mInput()
+	, mResult()
+	, pDistance(nullptr)
+	, vError()
+	, vBins()
+	, fTotal(0)
+	, mLock()
+{
+}
+
+void ErrorTracker::reset(const ConstImageView &input, const ConstImageView &result, Distance distance)
+{
+	mInput = input;
+	mResult = result;
+	pDistance = distance;
+
+	auto n = input.count();
+	vError.resize(n);
+	Counters::count(Counters::kCounterBytesAllocated, qint64(n) * sizeof(float));
+
+	Changes sums;
+	for (int i = 0; i < n; i++)
+	{
+		auto d = clean(this->distance(i));
+		vError[i] = d;
+		sums.vBins[bin(d)]++;
+		sums.fTotal += d;
+	}
+
+	QMutexLocker lock(&mLock);
+	vBins.resize(kBins);
+	for (int i = 0; i < kBins; i++)
+		vBins[i] = sums.vBins[i];
+
+	fTotal = sums.fTotal;
+}
+
+void ErrorTracker::clear()
+{
+	mInput = ConstImageView();
+	mResult = ConstImageView();
+	vError.clear();
+
+	QMutexLocker lock(&mLock);
+	vBins.clear();
+	fTotal = 0;
+}
+
+void ErrorTracker::set(int i, double d)
+{
+	auto e = clean(d);
+	auto old = vError[i];
+	vError[i] = e;
+
+	// total() and histogram() may read from another thread
+	QMutexLocker lock(&mLock);
+	vBins[bin(old)]--;
+	vBins[bin(e)]++;
+	fTotal += double(e) - double(old);
+}
+
+void ErrorTracker::set(int i, double d, Changes &changes)
+{
+	auto e = clean(d);
+	auto old = vError[i];
+	vError[i] = e;
+
+	changes.vBins[bin(old)]--;
+	changes.vBins[bin(e)]++;
+	changes.fTotal += double(e) - double(old);
+}
+
+void ErrorTracker::apply(const Changes &changes)
+{
+	QMutexLocker lock(&mLock);
+
+	for (int i = 0; i < kBins; i++)
+		vBins[i] += changes.vBins[i];
+
+	fTotal += changes.fTotal;
+}
+
+double ErrorTracker::total() const
+{
+	QMutexLocker lock(&mLock);
+	return fTotal;
+}
+
+double ErrorTracker::mean() const
+{
+	return vError.isEmpty() ? 0 : total() / vError.size();
+}
+
+QVector<int> ErrorTracker::histogram() const
+{
+	QMutexLocker lock(&mLock);
+	return vBins;
+}
+
+int ErrorTracker::bin(double d)
+{
+	if (!(d > 0))
+		return 0;
+
+	int e = 0;
+	std::frexp(d, &e); // d in [2^(e-1), 2^e)
+
+	return std::min(std::max(e + 8, 1), kBins - 1);
+}
+
+double ErrorTracker::binStart(int bin)
+{
+	return bin == 0 ? 0 : std::ldexp(1.0, bin - 9);
+}
@@ -0,0 +1,86 @@
+#ifndef ERRORTRACKER_H
+#define ERRORTRACKER_H
+
+#include "pixel.h"
+#include "imageview.h"
+#include <QVector>
+#include <QMutex>
+
+// Distance of every result pixel to its input pixel, with their total and a
+// histogram, kept up to date as pixels change instead of rescanning images.
+//
+// set() without Changes is for the thread that owns the technique, while no
+// worker runs, and takes the lock for every pixel. Hot loops record their
+// pixels in Changes of their own and apply() them when done, workers as well:
+// the pixels of two workers never overlap, only the sums are shared.
+class ErrorTracker
+{
+	public:
+		typedef double (*Distance)(Pixel a, Pixel b);
+
+		// Bin 0 counts exact matches, bin k distances in [2^(k-9), 2^(k-8)).
+		// Bin 1 also takes smaller distances, the last bin larger ones.
+		static const int kBins = 32;
+
+		struct Changes
+		{
+			Changes();
+
+			double fTotal;
+			int vBins[kBins];
+		};
+
+		ErrorTracker();
+
+		// Measures all of result against input, both stay referenced.
+		void reset(const ConstImageView &input, const ConstImageView &result, Distance distance);
+		void clear();
+
+		bool isEmpty() const
+		{
+			return vError.isEmpty();
+		}
+
+		// Distance between two colors with the distance of the technique.
+		double distance(Pixel input, Pixel result) const
+		{
+			return pDistance(input, result);
+		}
+
+		// Current distance of pixel i of the result to its input.
+		double distance(int i) const
+		{
+			return pDistance(Pixel(mInput.at(i)), Pixel(mResult.at(i)));
+		}
+
+		// Pixel i of the result changed and is now d away from its input.
+		void set(int i, double d);
+		void set(int i, double d, Changes &changes);
+
+		void apply(const Changes &changes);
+
+		double pixelError(int i) const
+		{
+			return vError[i];
+		}
+
+		double total() const;
+		double mean() const;
+		QVector<int> histogram() const;
+
+		static int bin(double d);
+
+		// Smallest distance of a bin.
+		static double binStart(int bin);
+
+	private:
+		ConstImageView mInput;
+		ConstImageView mResult;
+		Distance pDistance;
+		QVector<float> vError;
+		QVector<int> vBins;
+		double fTotal;
+		mutable QMutex mLock;
+};
+
+#endif // ERRORTRACKER_H
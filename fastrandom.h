@@ -0,0 +1,51 @@
+#ifndef FASTRANDOM_H
+#define FASTRANDOM_H
+
+#include <QtGlobal>
+
+// Small seedable generator (xorshift64*) for hot loops on worker threads,
+// where qrand() would share one state and only give RAND_MAX values.
+class FastRandom
+{
+	public:
+		explicit FastRandom(quint64 seed = 0)
+		{
+			setSeed(seed);
+		}
+
+		void setSeed(quint64 seed)
+		{
+			iState = mix(seed);
+			if (iState == 0)
+				iState = 0x9e3779b97f4a7c15ull;
+		}
+
+		quint32 next()
+		{
+			iState ^= iState >> 12;
+			iState ^= iState << 25;
+			iState ^= iState >> 27;
+			return quint32((iState * 0x2545f4914f6cdd1dull) >> 32);
+		}
+
+		// Uniform in [0, n) by multiply and shift, the bias is far below
+		// anything a swap proposal cares about.
+		int bounded(int n)
+		{
+			return int((quint64(next()) * quint64(n)) >> 32);
+		}
+
+		// splitmix64 finalizer, to derive unrelated seeds from close ones.
+		static quint64 mix(quint64 x)
+		{
+			x += 0x9e3779b97f4a7c15ull;
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+
+	private:
+		quint64 iState;
+};
+
+#endif // FASTRANDOM_H
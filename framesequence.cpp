@@ -0,0 +1,210 @@
+#include "framesequence.h"
+#include "algorithmregistry.h"
+#include "imageview.h"
+#include "errortracker.h"
+#include "trace.h"
+
+#include <QScopedPointer>
+#include <algorithm>
+#include <cmath>
+
+FrameSequence::FrameSequence()
+	: mPalette()
+	, mInput()
+	, mResult()
+	, mCounters()
+	, sError()
+	, fThreshold(0)
+	, fError(0)
+	, iTechnique(0)
+	, iDistance(0)
+	, iMaxSteps(1000)
+	, iFrames(0)
+	, iChanged(0)
+	, iMatched(0)
+{
+}
+
+void FrameSequence::setTechnique(int technique, int distance)
+{
+	iTechnique = technique;
+	iDistance = distance;
+}
+
+void FrameSequence::setThreshold(double threshold)
+{
+	fThreshold = threshold;
+}
+
+void FrameSequence::setMaxSteps(int steps)
+{
+	iMaxSteps = steps;
+}
+
+void FrameSequence::reset(const QImage &palette)
+{
+	mPalette = palette;
+	mInput = QImage();
+	mResult = QImage();
+	mCounters.reset();
+	sError.clear();
+	fError = 0;
+	iFrames = 0;
+	iChanged = 0;
+	iMatched = 0;
+}
+
+QVector<int> FrameSequence::changedPixels(const QImage &input, int &width)
+{
+	auto distance = distanceFunction(iDistance);
+	auto in = constImageView(&input);
+	auto n = in.count();
+
+	QVector<int> pixels;
+	if (iFrames > 0)
+	{
+		auto previous = constImageView(&mInput);
+		for (int i = 0; i < n; i++)
+		{
+			if (distance(Pixel(previous.at(i)), Pixel(in.at(i))) > fThreshold)
+				pixels.append(i);
+		}
+
+		iChanged = pixels.size();
+		if (pixels.isEmpty())
+			return pixels;
+	}
+
+	// the most square rectangle that holds the changed pixels
+	width = int(std::ceil(std::sqrt(double(pixels.size()))));
+	auto count = width > 0 ? width * ((pixels.size() + width - 1) / width) : n;
+
+	if (iFrames == 0 || count >= n)
+	{
+		iChanged = iFrames == 0 ? n : iChanged;
+		width = input.width();
+		pixels.resize(n);
+		for (int i = 0; i < n; i++)
+			pixels[i] = i;
+
+		return pixels;
+	}
+
+	// filled up with the unchanged pixels that are furthest from their input
+	if (count > pixels.size())
+	{
+		auto result = constImageView(&mResult);
+
+		QVector<QPair<double, int>> unchanged;
+		unchanged.reserve(n - pixels.size());
+		for (int i = 0, next = 0; i < n; i++)
+		{
+			if (next < pixels.size() && pixels[next] == i)
+			{
+				next++;
+				continue;
+			}
+
+			// undefined distances count as a match, like in ErrorTracker
+			auto d = distance(Pixel(in.at(i)), Pixel(result.at(i)));
+			unchanged.append(qMakePair(d > 0 ? -d : 0.0, i));
+		}
+
+		auto extra = count - pixels.size();
+		std::nth_element(unchanged.begin(), unchanged.begin() + (extra - 1), unchanged.end());
+		for (int i = 0; i < extra; i++)
+			pixels.append(unchanged[i].second);
+
+		std::sort(pixels.begin(), pixels.end());
+	}
+
+	return pixels;
+}
+
+bool FrameSequence::next(const QImage &frame)
+{
+	TraceScope trace("frame");
+	trace.setArg("frame", iFrames);
+
+	auto alpha = frame.hasAlphaChannel() || mPalette.hasAlphaChannel();
+	auto format = alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+	auto input = frame.convertToFormat(format);
+	auto n = input.width() * input.height();
+
+	if (iFrames > 0 && input.size() != mInput.size())
+	{
+		sError = "Frames must all have the same size";
+		return false;
+	}
+
+	auto width = 0;
+	auto pixels = changedPixels(input, width);
+	iMatched = pixels.size();
+	trace.setArg("matched", iMatched);
+
+	if (!pixels.isEmpty())
+	{
+		// the part and the colors it held, or the whole frame and the palette
+		auto whole = pixels.size() == n;
+		QImage part = input;
+		QImage partPalette = iFrames == 0 ? mPalette : mResult;
+
+		if (!whole)
+		{
+			part = QImage(width, pixels.size() / width, format);
+			partPalette = QImage(width, pixels.size() / width, format);
+
+			auto in = constImageView(&input);
+			auto previous = constImageView(&mResult);
+			auto partView = imageView(&part);
+			auto paletteView = imageView(&partPalette);
+			for (int k = 0; k < pixels.size(); k++)
+			{
+				partView.set(k, in.at(pixels[k]));
+				paletteView.set(k, previous.at(pixels[k]));
+			}
+		}
+
+		QScopedPointer<IAlgorithm> algo(createAlgorithm(iTechnique, iDistance));
+		algo->setErrorDistance(distanceFunction(iDistance));
+
+		bool ready;
+		{
+			CounterScope scope(algo->counters(), Counters::kPhaseSetup);
+			ready = algo->setup(&part, &partPalette);
+		}
+
+		if (!ready)
+		{
+			sError = "Setup failed";
+			return false;
+		}
+
+		auto done = false;
+		for (int step = 0; !done && (algo->finishes() || step < iMaxSteps); step++)
+			done = algo->process();
+
+		mCounters.merge(algo->counters().values());
+
+		if (whole)
+		{
+			mResult = algo->result()->copy();
+		}
+		else
+		{
+			auto matched = constImageView(algo->result());
+			auto result = imageView(&mResult);
+			for (int k = 0; k < pixels.size(); k++)
+				result.set(pixels[k], matched.at(k));
+		}
+	}
+
+	mInput = input;
+	iFrames++;
+
+	ErrorTracker error;
+	error.reset(constImageView(&mInput), constImageView(&mResult), distanceFunction(iDistance));
+	fError = error.total();
+
+	return true;
+}
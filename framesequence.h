@@ -0,0 +1,103 @@
+#ifndef FRAMESEQUENCE_H
+#define FRAMESEQUENCE_H
+
+#include "counters.h"
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+// Runs one technique over the frames of an animation against one palette.
+//
+// The first frame is solved in full. Every later one starts from the result
+// of the frame before: pixels whose input color moved by at most the
+// threshold keep their color, the others are cut out into a smaller image
+// together with the colors they held, which becomes its palette. The
+// technique solves that pair like any other, swap techniques starting from
+// the previous assignment since they start from the palette, and the part is
+// written back in place. The colors of a frame stay those of the palette.
+class FrameSequence
+{
+	public:
+		FrameSequence();
+
+		// Indices as in techniqueList() and distanceList().
+		void setTechnique(int technique, int distance);
+
+		// How far an input pixel may move, with the distance of the
+		// technique, before it is matched again. 0 by default, any change.
+		void setThreshold(double threshold);
+
+		// Update slices of every frame, for techniques that never finish. The
+		// others run to the end.
+		void setMaxSteps(int steps);
+
+		// Starts over, the next frame is solved in full against palette.
+		void reset(const QImage &palette);
+
+		// Matches the next frame, which must have the size of the frames
+		// before it. The first one gets the palette weighted to its pixel
+		// count when they differ, see IAlgorithm::pCurrent.
+		bool next(const QImage &frame);
+
+		// Result of the last frame, 32 bit.
+		const QImage &result() const
+		{
+			return mResult;
+		}
+
+		int frames() const
+		{
+			return iFrames;
+		}
+
+		// Pixels of the last frame over the threshold, and how many the
+		// technique matched again: the whole frame, or the changed ones filled
+		// up to a rectangle with the unchanged ones furthest from their input.
+		int changed() const
+		{
+			return iChanged;
+		}
+
+		int matched() const
+		{
+			return iMatched;
+		}
+
+		// Total distance of the last result to its frame.
+		double error() const
+		{
+			return fError;
+		}
+
+		// Of all frames so far.
+		Counters &counters()
+		{
+			return mCounters;
+		}
+
+		QString errorString() const
+		{
+			return sError;
+		}
+
+	private:
+		// Pixels of the frame the technique runs on, in row major order, and
+		// the width of the part they make. Empty when nothing changed.
+		QVector<int> changedPixels(const QImage &input, int &width);
+
+		QImage mPalette;
+		QImage mInput;		// previous frame
+		QImage mResult;
+		Counters mCounters;
+		QString sError;
+		double fThreshold;
+		double fError;
+		int iTechnique;
+		int iDistance;
+		int iMaxSteps;
+		int iFrames;
+		int iChanged;
+		int iMatched;
+};
+
+#endif // FRAMESEQUENCE_H
@@ -1,64 +1,156 @@
-#include "ialgorithm.h"
-#include <QImage>
-#include <assert.h>
-
-IAlgorithm::IAlgorithm()
-	: pDistance(rtm_distance)
-	, pInput(nullptr)
-	, pPalette(nullptr)
-	, pCurrent(nullptr)
-	, iCount(0)
-	, iInputHeight(0)
-	, iInputWidth(0)
-	, iPaletteHeight(0)
-	, iPaletteWidth(0)
-	, bFinished(false)
-{}
-
-IAlgorithm::~IAlgorithm()
-{
-	delete pInput;
-	delete pPalette;
-	delete pCurrent;
-
-	pInput   = nullptr;
-	pPalette = nullptr;
-	pCurrent = nullptr;
-}
-
-bool IAlgorithm::setup(QImage *input, QImage *palette, DistanceFunction func)
-{
-	pDistance = func;
-
-	if (!input)
-		return false;
-
-	if (!palette)
-		return false;
-
-	pInput = new QImage(*input);
-	pPalette = new QImage(*palette);
-
-	iInputWidth = pInput->width();
-	iInputHeight = pInput->height();
-	iPaletteWidth = pPalette->width();
-	iPaletteHeight = pPalette->height();
-	iCount = iInputWidth * iInputHeight;
-	assert(iCount == iPaletteHeight * iPaletteWidth);
-
-	delete pCurrent;
-	pCurrent = new QImage(pPalette->bits(), iInputWidth, iInputHeight, pInput->bytesPerLine(), pPalette->format());
-
-
-	bFinished = !(iCount == iPaletteHeight * iPaletteWidth);
-
-	return !bFinished;
-}
-
-bool IAlgorithm::process()
-{
-	if (bFinished)
-		return true;
-
-	return this->update();
-}
+#include "ialgorithm.h"
+#include "paletteindex.h"
+#include "colorhistogram.h"
+#include <QImage>
+
+// Fills result with the colors of a palette of another pixel count, each
+// color as often as its quota, spread over its palette pixels, in the row
+// major order of the palette.
+static void spreadPalette(const QImage *palette, ImageView result)
+{
+	TraceScope trace("spreadPalette");
+
+	ColorHistogram hist;
+	hist.build(palette);
+
+	QVector<int> share(hist.pixels());
+	for (int c = 0; c < hist.size(); c++)
+	{
+		auto count = qint64(hist.count(c));
+		auto quota = qint64(hist.quota(c, result.count()));
+		auto indices = hist.indices(c);
+		for (qint64 t = 0; t < count; t++)
+			share[indices[t]] = int((t + 1) * quota / count - t * quota / count);
+	}
+
+	auto view = constImageView(palette);
+	for (int i = 0, j = 0; j < share.size(); j++)
+	{
+		for (int k = 0; k < share[j]; k++)
+			result.set(i++, view.at(j));
+	}
+}
+
+IAlgorithm::IAlgorithm()
+	: pInput(nullptr)
+	, pPalette(nullptr)
+	, pCurrent(nullptr)
+	, mInputView()
+	, mCurrentView()
+	, mError()
+	, pErrorDistance(rtm_distance)
+	, pPaletteIndex(nullptr)
+	, mDirty()
+	, mCounters()
+	, iCancelled(0)
+	, iCount(0)
+	, iInputHeight(0)
+	, iInputWidth(0)
+	, iPaletteHeight(0)
+	, iPaletteWidth(0)
+	, bFinished(false)
+{}
+
+IAlgorithm::~IAlgorithm()
+{
+	delete pInput;
+	delete pPalette;
+	delete pCurrent;
+
+	pInput   = nullptr;
+	pPalette = nullptr;
+	pCurrent = nullptr;
+}
+
+bool IAlgorithm::setup(QImage *input, QImage *palette)
+{
+	TraceScope trace("setup");
+
+	// a new run, an instance can be set up again after a cancel
+	iCancelled.storeRelease(0);
+	mError.clear();
+	mDirty.clear();
+	mCounters.reset();
+
+	if (!input)
+		return false;
+
+	if (!palette)
+		return false;
+
+	delete pInput;
+	delete pPalette;
+
+	// one 32 bit format for both, so the views can read and write raw pixels
+	auto alpha = input->hasAlphaChannel() || palette->hasAlphaChannel();
+	auto format = alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+	pInput = new QImage(input->convertToFormat(format));
+	pPalette = new QImage(palette->convertToFormat(format));
+
+	iInputWidth = pInput->width();
+	iInputHeight = pInput->height();
+	iPaletteWidth = pPalette->width();
+	iPaletteHeight = pPalette->height();
+	iCount = iInputWidth * iInputHeight;
+
+	// both images are copies
+	Counters::count(Counters::kCounterBytesAllocated, qint64(pInput->bytesPerLine()) * iInputHeight);
+	Counters::count(Counters::kCounterBytesAllocated, qint64(pPalette->bytesPerLine()) * iPaletteHeight);
+
+	// the result shares the palette bits, or holds the palette spread to
+	// the input pixel count when the sizes differ
+	delete pCurrent;
+	pCurrent = nullptr;
+
+	bFinished = iCount > 0 && iPaletteWidth * iPaletteHeight == 0;
+	if (bFinished)
+		return false;
+
+	if (iCount == iPaletteHeight * iPaletteWidth)
+	{
+		pCurrent = new QImage(pPalette->bits(), iInputWidth, iInputHeight, pInput->bytesPerLine(), pPalette->format());
+	}
+	else
+	{
+		pCurrent = new QImage(iInputWidth, iInputHeight, format);
+		spreadPalette(pPalette, imageView(pCurrent));
+		Counters::count(Counters::kCounterBytesAllocated, qint64(pCurrent->bytesPerLine()) * iInputHeight);
+	}
+
+	mInputView = constImageView(pInput);
+	mCurrentView = imageView(pCurrent);
+	mError.reset(mInputView, mCurrentView, pErrorDistance);
+	mDirty.reset(iInputWidth, iInputHeight);
+
+	// an image without pixels is matched already, process() returns at once
+	bFinished = iCount == 0;
+
+	return true;
+}
+
+const PaletteIndex *IAlgorithm::paletteIndex() const
+{
+	if (!pPaletteIndex || !pPalette)
+		return nullptr;
+
+	auto fits = pPaletteIndex->width() == iPaletteWidth && pPaletteIndex->height() == iPaletteHeight
+		&& iCount == iPaletteWidth * iPaletteHeight;
+	return fits ? pPaletteIndex : nullptr;
+}
+
+bool IAlgorithm::process()
+{
+	if (bFinished || isCancelled())
+		return true;
+
+	bool done;
+	{
+		TraceScope trace("update");
+		CounterScope scope(mCounters, Counters::kPhaseMatch);
+		done = this->update();
+	}
+
+	emit errorChanged(mError.total());
+
+	return done;
+}
@@ -1,49 +1,195 @@
-#ifndef IALGORITHM_H
-#define IALGORITHM_H
-
-#include <QString>
-#include <functional>
-#include "pixel.h"
-
-class QImage;
-typedef std::function<double(Pixel, Pixel)> DistanceFunction;
-
-class IAlgorithm : public QObject
-{
-	Q_OBJECT
-	public:
-		IAlgorithm();
-		virtual ~IAlgorithm();
-
-		virtual bool setup(QImage *input, QImage *palette, DistanceFunction func);
-		virtual bool update() = 0;
-		virtual QString name() = 0;
-		virtual QImage *result()
-		{
-			return pCurrent;
-		}
-		
-		bool process();
-
-		static const int kUpdateSize = 1000;
-
-	signals:
-		void step();
-		void finished(QImage *result);
-
-	protected:
-		DistanceFunction pDistance;
-		QImage *pInput;
-		QImage *pPalette;
-		QImage *pCurrent; // result
-
-		int iCount;
-		int iInputHeight;
-		int iInputWidth;
-		int iPaletteHeight;
-		int iPaletteWidth;
-
-		bool bFinished;
-};
-
-#endif // IALGORITHM_H
+#ifndef IALGORITHM_H
+#define IALGORITHM_H
+
+#include <QString>
+#include <QAtomicInt>
+#include "pixel.h"
+#include "imageview.h"
+#include "errortracker.h"
+#include "counters.h"
+#include "dirtytiles.h"
+#include "trace.h"
+
+class QImage;
+class PaletteIndex;
+
+class IAlgorithm : public QObject
+{
+	Q_OBJECT
+	public:
+		IAlgorithm();
+		virtual ~IAlgorithm();
+
+		virtual bool setup(QImage *input, QImage *palette);
+		virtual bool update() = 0;
+		virtual QString name() = 0;
+		virtual QImage *result()
+		{
+			return pCurrent;
+		}
+
+		// False for techniques whose update() never returns true, they run
+		// until the caller stops asking for update slices.
+		virtual bool finishes() const
+		{
+			return true;
+		}
+
+		// Distance of every result pixel to its input, kept up to date while the
+		// technique runs, with the distance it was created for.
+		const ErrorTracker &error() const
+		{
+			return mError;
+		}
+
+		void setErrorDistance(ErrorTracker::Distance distance)
+		{
+			pErrorDistance = distance;
+		}
+
+		// Palette data computed ahead for the palette and distance this
+		// technique runs with, see PaletteIndex. setup() takes what it can
+		// from it instead of computing it. Caller keeps it alive through setup.
+		void setPaletteIndex(const PaletteIndex *index)
+		{
+			pPaletteIndex = index;
+		}
+
+		// Tiles of the result written since a view last took them.
+		DirtyTiles &dirty()
+		{
+			return mDirty;
+		}
+
+		// Hot path counters of the current run. process() times the update
+		// slices, callers can time setup() with a CounterScope.
+		Counters &counters()
+		{
+			return mCounters;
+		}
+
+		// Color space of the per pixel caches this technique reads, see metric.h.
+		virtual ColorSpace colorSpace() const
+		{
+			return kColorSpaceRGB;
+		}
+		
+		bool process();
+
+		// Asks the current run to stop, from any thread. process() returns
+		// true from then on and background workers of the technique stop early,
+		// until setup() starts the next run.
+		void cancel()
+		{
+			iCancelled.storeRelease(1);
+		}
+
+		bool isCancelled() const
+		{
+			return iCancelled.loadAcquire() != 0;
+		}
+
+		static const int kUpdateSize = 1000;
+
+	signals:
+		void step();
+		void finished(QImage *result);
+		void errorChanged(double total);
+
+	protected:
+		QImage *pInput;
+		QImage *pPalette;
+
+		// The result. Starts as the palette bits, or when the palette has
+		// another pixel count, as its colors weighted to the input one: each
+		// color as often as its share of the palette (ColorHistogram::quota).
+		// Techniques take the palette colors from it, never from pPalette.
+		QImage *pCurrent;
+
+		// Raw access to pInput and pCurrent, for the hot loops.
+		ConstImageView mInputView;
+		ImageView mCurrentView;
+
+		// Writes pixel i of the result, d away from its input, and keeps mError
+		// and mDirty in sync. Techniques measure d from the colors they already
+		// converted. The Changes forms are for worker threads, see ErrorTracker.
+		void setResult(int i, QRgb c, double d)
+		{
+			mCurrentView.set(i, c);
+			mError.set(i, d);
+			mDirty.mark(i);
+		}
+
+		void setResult(int i, QRgb c, double d, ErrorTracker::Changes &changes)
+		{
+			mCurrentView.set(i, c);
+			mError.set(i, d, changes);
+			mDirty.mark(i);
+		}
+
+		// Same, measuring d with the error distance, which converts both
+		// colors again. For techniques that hold no converted colors.
+		void setResult(int i, QRgb c)
+		{
+			setResult(i, c, mError.distance(Pixel(mInputView.at(i)), Pixel(c)));
+		}
+
+		void setResult(int i, QRgb c, ErrorTracker::Changes &changes)
+		{
+			setResult(i, c, mError.distance(Pixel(mInputView.at(i)), Pixel(c)), changes);
+		}
+
+		// Same for n pixels of a single input color, d away from c.
+		void setResults(const int *indices, int n, QRgb c, double d)
+		{
+			ErrorTracker::Changes changes;
+			setResults(indices, n, c, d, changes);
+			mError.apply(changes);
+		}
+
+		void setResults(const int *indices, int n, QRgb c, double d, ErrorTracker::Changes &changes)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				mCurrentView.set(indices[i], c);
+				mError.set(indices[i], d, changes);
+				mDirty.mark(indices[i]);
+			}
+		}
+
+		// Same, measuring d once with the error distance.
+		void setResults(const int *indices, int n, QRgb c)
+		{
+			if (n > 0)
+				setResults(indices, n, c, mError.distance(Pixel(mInputView.at(indices[0])), Pixel(c)));
+		}
+
+		void setResults(const int *indices, int n, QRgb c, ErrorTracker::Changes &changes)
+		{
+			if (n > 0)
+				setResults(indices, n, c, mError.distance(Pixel(mInputView.at(indices[0])), Pixel(c)), changes);
+		}
+
+		// The palette index, or nullptr when there is none, it was built for a
+		// palette of another size or the palette gets weighted. Valid during
+		// setup.
+		const PaletteIndex *paletteIndex() const;
+
+		ErrorTracker mError;
+		ErrorTracker::Distance pErrorDistance;
+		const PaletteIndex *pPaletteIndex;
+		DirtyTiles mDirty;
+		Counters mCounters;
+
+		QAtomicInt iCancelled;
+
+		int iCount;
+		int iInputHeight;
+		int iInputWidth;
+		int iPaletteHeight;
+		int iPaletteWidth;
+
+		bool bFinished;
+};
+
+#endif // IALGORITHM_H
@@ -0,0 +1,72 @@
+#include "imagepreview.h"
+#include "imageview.h"
+#include "dirtytiles.h"
+#include "trace.h"
+
+ImagePreview::ImagePreview()
+	: pSource(nullptr)
+	, mImage()
+	, iStep(1)
+{
+}
+
+void ImagePreview::reset(const QImage *source, const QSize &maxSize)
+{
+	pSource = source;
+	iStep = 1;
+
+	if (!source || source->isNull())
+	{
+		mImage = QImage();
+		return;
+	}
+
+	auto w = source->width();
+	auto h = source->height();
+	while ((w + iStep - 1) / iStep > maxSize.width() || (h + iStep - 1) / iStep > maxSize.height())
+		iStep++;
+
+	mImage = QImage((w + iStep - 1) / iStep, (h + iStep - 1) / iStep, source->format());
+	sample(QRect(0, 0, w, h));
+}
+
+void ImagePreview::clear()
+{
+	pSource = nullptr;
+	mImage = QImage();
+}
+
+bool ImagePreview::update(DirtyTiles &dirty)
+{
+	auto rects = dirty.take();
+	if (!pSource || rects.isEmpty())
+		return false;
+
+	TraceScope trace("preview", "gui");
+	trace.setArg("tiles", rects.size());
+
+	for (auto &rect : rects)
+		sample(rect);
+
+	return true;
+}
+
+void ImagePreview::sample(const QRect &rect)
+{
+	// nearest pixel: preview pixel p shows source pixel p * iStep
+	auto source = constImageView(pSource);
+	auto preview = imageView(&mImage);
+
+	auto x0 = (rect.left() + iStep - 1) / iStep;
+	auto x1 = (rect.left() + rect.width() + iStep - 1) / iStep;
+	auto y0 = (rect.top() + iStep - 1) / iStep;
+	auto y1 = (rect.top() + rect.height() + iStep - 1) / iStep;
+
+	for (int y = y0; y < y1; y++)
+	{
+		auto in = source.row(y * iStep);
+		auto out = preview.row(y);
+		for (int x = x0; x < x1; x++)
+			out[x] = in[x * iStep];
+	}
+}
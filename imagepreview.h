@@ -0,0 +1,38 @@
+#ifndef IMAGEPREVIEW_H
+#define IMAGEPREVIEW_H
+
+#include <QImage>
+#include <QSize>
+
+class DirtyTiles;
+
+// A downscaled copy of an image that is being written, for showing progress
+// without converting the whole image on every step. Only the tiles marked
+// dirty are sampled again.
+class ImagePreview
+{
+	public:
+		ImagePreview();
+
+		// Starts over with source shrunk by a whole factor to fit in maxSize.
+		// source must stay alive and keep its size until the next reset().
+		void reset(const QImage *source, const QSize &maxSize);
+		void clear();
+
+		// Samples the tiles taken from dirty, returns false if none were.
+		bool update(DirtyTiles &dirty);
+
+		const QImage &image() const
+		{
+			return mImage;
+		}
+
+	private:
+		void sample(const QRect &rect);
+
+		const QImage *pSource;
+		QImage mImage;
+		int iStep; // source pixels per preview pixel, in each direction
+};
+
+#endif // IMAGEPREVIEW_H
@@ -1,11 +1,11 @@
-#include "imageselectlabel.h"
-
-ImageSelectLabel::ImageSelectLabel(QWidget *parent)
-	: QLabel(parent)
-{
-}
-
-void ImageSelectLabel::mousePressEvent(QMouseEvent *)
-{
-	emit clicked();
-}
+#include "imageselectlabel.h"
+
+ImageSelectLabel::ImageSelectLabel(QWidget *parent)
+	: QLabel(parent)
+{
+}
+
+void ImageSelectLabel::mousePressEvent(QMouseEvent *)
+{
+	emit clicked();
+}
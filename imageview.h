@@ -0,0 +1,107 @@
+#ifndef IMAGEVIEW_H
+#define IMAGEVIEW_H
+
+#include <QImage>
+
+// Unchecked access to the pixels of a 32 bit image, Format_RGB32 or
+// Format_ARGB32 (IAlgorithm::setup converts to those once). Values are QRgb,
+// the same QImage::pixel() returns for these formats, without its bounds
+// checks, format switch and detach on every call.
+//
+// Scanlines of 32 bit images are never padded, so pixel i in row major
+// order (i = y * width + x) can be reached directly with at(i).
+template <class T>
+class ImageViewBase
+{
+	public:
+		ImageViewBase()
+			: pBits(nullptr)
+			, iWidth(0)
+			, iHeight(0)
+			, iStride(0)
+		{
+		}
+
+		ImageViewBase(T *bits, int width, int height, int bytesPerLine)
+			: pBits(bits)
+			, iWidth(width)
+			, iHeight(height)
+			, iStride(bytesPerLine / int(sizeof(QRgb)))
+		{
+			Q_ASSERT(iStride == iWidth);
+		}
+
+		// A view of a writable image is also a read only one.
+		template <class U>
+		ImageViewBase(const ImageViewBase<U> &other)
+			: pBits(other.row(0))
+			, iWidth(other.width())
+			, iHeight(other.height())
+			, iStride(other.width())
+		{
+		}
+
+		int width() const
+		{
+			return iWidth;
+		}
+
+		int height() const
+		{
+			return iHeight;
+		}
+
+		int count() const
+		{
+			return iWidth * iHeight;
+		}
+
+		T *row(int y) const
+		{
+			return pBits + y * iStride;
+		}
+
+		QRgb pixel(int x, int y) const
+		{
+			return pBits[y * iStride + x];
+		}
+
+		void setPixel(int x, int y, QRgb c) const
+		{
+			pBits[y * iStride + x] = c;
+		}
+
+		QRgb at(int i) const
+		{
+			return pBits[i];
+		}
+
+		void set(int i, QRgb c) const
+		{
+			pBits[i] = c;
+		}
+
+	private:
+		T *pBits;
+		int iWidth;
+		int iHeight;
+		int iStride; // in pixels
+};
+
+typedef ImageViewBase<QRgb> ImageView;
+typedef ImageViewBase<const QRgb> ConstImageView;
+
+// Views of an image in one of the formats above. imageView() calls bits(),
+// which detaches the image once here, so threads writing through the view
+// never trigger a copy. constImageView() never detaches.
+inline ImageView imageView(QImage *img)
+{
+	return ImageView(reinterpret_cast<QRgb *>(img->bits()), img->width(), img->height(), img->bytesPerLine());
+}
+
+inline ConstImageView constImageView(const QImage *img)
+{
+	return ConstImageView(reinterpret_cast<const QRgb *>(img->constBits()), img->width(), img->height(), img->bytesPerLine());
+}
+
+#endif // IMAGEVIEW_H
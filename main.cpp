@@ -1,11 +1,26 @@
-#include "mainwindow.h"
-#include <QApplication>
-
-int main(int argc, char *argv[])
-{
-	QApplication a(argc, argv);
-	MainWindow w;
-	w.show();
-
-	return a.exec();
-}
+#include "mainwindow.h"
+#include "trace.h"
+#include <QApplication>
+
+int main(int argc, char *argv[])
+{
+	QApplication a(argc, argv);
+
+	// RTM_TRACE=file.json records a timeline of the session, see trace.h
+	auto trace = QString::fromLocal8Bit(qgetenv("RTM_TRACE"));
+	if (!trace.isEmpty())
+		Trace::start();
+
+	MainWindow w;
+	w.show();
+
+	auto result = a.exec();
+
+	if (!trace.isEmpty())
+	{
+		Trace::stop();
+		Trace::save(trace);
+	}
+
+	return result;
+}
@@ -0,0 +1,251 @@
+#ifndef METRIC_H
+#define METRIC_H
+
+#include "pixel.h"
+#include "colorcache.h"
+#include "distancebatch.h"
+#include "imageview.h"
+#include "counters.h"
+#include <cmath>
+#include <limits>
+
+// Distances as types, so techniques can be instantiated per metric and the
+// distance gets inlined into their hot loops. Every metric provides:
+//
+//   Color                     what distance() works on, a Pixel or converted coordinates
+//   Cache                     the ColorCache type color() reads from
+//   kSpace                    color space of the ColorCache the technique must build
+//   name()                    display name
+//   color(img, cache, i)      color of pixel i of an image view, from the view or the cache
+//   color(p, cache, i)        same for entry i of a list of colors and its cache
+//   convert(p)                a single color, converted without any cache
+//   distance(a, b)            the formula itself
+//   keys(row, cache, first, n, out)
+//                             sort keys, distance of n pixels to black; row holds the
+//                             raw pixels, the cache is read from index first on
+//
+// The formulas are templates on their scalar type T, the float forms compute
+// and cache in single precision, distances and keys still come out as double.
+
+// Display name of a metric, marked in its float form.
+template <class T>
+inline const char *metricName(const char *name, const char *floatName)
+{
+	return sizeof(T) == sizeof(float) ? floatName : name;
+}
+
+struct RgbMetric
+{
+	typedef Pixel Color;
+	typedef ColorCache Cache;
+	static const ColorSpace kSpace = kColorSpaceRGB;
+
+	template <class C>
+	static Color color(const ConstImageView &img, const C &, int i)
+	{
+		return Pixel(img.at(i));
+	}
+
+	template <class C>
+	static Color color(Pixel p, const C &, int)
+	{
+		return p;
+	}
+
+	static Color convert(Pixel p)
+	{
+		return p;
+	}
+};
+
+// Caches of the other scalar type, like the double points of the k-d tree
+// techniques, are read with a cast.
+template <ColorSpace S, class T>
+struct NormalizedMetric
+{
+	typedef PixelNormalizedT<T> Color;
+	typedef ColorCacheT<T> Cache;
+	static const ColorSpace kSpace = S;
+
+	template <class U>
+	static Color color(const ConstImageView &, const ColorCacheT<U> &cache, int i)
+	{
+		return normalizedCast<T>(cache.at(i));
+	}
+
+	template <class U>
+	static Color color(Pixel, const ColorCacheT<U> &cache, int i)
+	{
+		return normalizedCast<T>(cache.at(i));
+	}
+
+	static Color convert(Pixel p)
+	{
+		return RGBtoColorSpace<T>(p, S);
+	}
+};
+
+template <class T>
+struct RtmDistanceT : public RgbMetric
+{
+	static const char *name()
+	{
+		return metricName<T>("Reference Distance", "Reference Distance (float)");
+	}
+
+	static double distance(const Color &a, const Color &b)
+	{
+		return rtm_distance<T>(a, b);
+	}
+
+	static void keys(const Pixel *row, const ColorCache &, int, int n, double *out)
+	{
+		if (sizeof(T) == sizeof(float))
+			rtm_distance_batch_float(empty, row, out, n);
+		else
+			rtm_distance_batch(empty, row, out, n);
+	}
+};
+
+struct ColorMetric : public RgbMetric
+{
+	static const char *name()
+	{
+		return "Color Metric";
+	}
+
+	static double distance(const Color &a, const Color &b)
+	{
+		return cmetric(a, b);
+	}
+
+	static void keys(const Pixel *row, const ColorCache &, int, int n, double *out)
+	{
+		cmetric_batch(empty, row, out, n);
+	}
+};
+
+template <class T>
+struct CieDe2000T : public NormalizedMetric<kColorSpaceLab, T>
+{
+	typedef PixelNormalizedT<T> Color;
+
+	static const char *name()
+	{
+		return metricName<T>("CieDe 2000", "CieDe 2000 (float)");
+	}
+
+	static double distance(const Color &a, const Color &b)
+	{
+		return ciede2000_lab(a, b);
+	}
+
+	static void keys(const Pixel *, const ColorCacheT<T> &cache, int first, int n, double *out)
+	{
+		auto black = RGBtoLAB<T>(empty);
+		for (int i = 0; i < n; i++)
+			out[i] = ciede2000_lab(cache.at(first + i), black);
+	}
+};
+
+template <class T>
+struct Cie1976T : public NormalizedMetric<kColorSpaceLab, T>
+{
+	typedef PixelNormalizedT<T> Color;
+
+	static const char *name()
+	{
+		return metricName<T>("Cie 1967", "Cie 1967 (float)");
+	}
+
+	static double distance(const Color &a, const Color &b)
+	{
+		return cie1976_lab(a, b);
+	}
+
+	static void keys(const Pixel *, const ColorCacheT<T> &cache, int first, int n, double *out)
+	{
+		cie1976_batch(RGBtoLAB<T>(empty), cache.channel(0) + first, cache.channel(1) + first, cache.channel(2) + first, out, n);
+	}
+};
+
+template <class T>
+struct HueDistanceT : public NormalizedMetric<kColorSpaceHSV, T>
+{
+	typedef PixelNormalizedT<T> Color;
+
+	static const char *name()
+	{
+		return metricName<T>("HSV Hue Based", "HSV Hue Based (float)");
+	}
+
+	static double distance(const Color &a, const Color &b)
+	{
+		return hue_distance_hsv(a, b);
+	}
+
+	static void keys(const Pixel *, const ColorCacheT<T> &cache, int first, int n, double *out)
+	{
+		auto black = RGBtoHSV<T>(empty);
+		for (int i = 0; i < n; i++)
+			out[i] = hue_distance_hsv(cache.at(first + i), black);
+	}
+};
+
+typedef RtmDistanceT<double> RtmDistance;
+typedef CieDe2000T<double> CieDe2000;
+typedef Cie1976T<double> Cie1976;
+typedef HueDistanceT<double> HueDistance;
+
+typedef RtmDistanceT<float> RtmDistanceFloat;
+typedef CieDe2000T<float> CieDe2000Float;
+typedef Cie1976T<float> Cie1976Float;
+typedef HueDistanceT<float> HueDistanceFloat;
+
+// Sort keys of a list of colors, converted to the space of the metric first.
+// Undefined keys, like the hue of a grey, would break any sort, they come out
+// as -inf to go first and together.
+typedef void (*ColorKeysFunction)(const QVector<Pixel> &colors, double *out);
+
+template <class Metric>
+void colorKeys(const QVector<Pixel> &colors, double *out)
+{
+	typename Metric::Cache cache;
+	if (Metric::kSpace != kColorSpaceRGB)
+		cache.build(colors, Metric::kSpace);
+
+	Metric::keys(colors.constData(), cache, 0, colors.size(), out);
+	Counters::count(Counters::kCounterDistances, colors.size());
+
+	for (int i = 0; i < colors.size(); i++)
+	{
+		if (std::isnan(out[i]))
+			out[i] = -std::numeric_limits<double>::infinity();
+	}
+}
+
+// Distance of two plain colors, for code that holds no cache.
+template <class Metric>
+double pixelDistance(Pixel a, Pixel b)
+{
+	return Metric::distance(Metric::convert(a), Metric::convert(b));
+}
+
+// Explicit instantiation of a technique template for every metric above, in
+// display order, the float forms after the double ones. The header declares
+// them extern, the .cpp defines them.
+#define RTP_FOR_EACH_METRIC(prefix, T) \
+	prefix template class T<RtmDistance>; \
+	prefix template class T<ColorMetric>; \
+	prefix template class T<CieDe2000>; \
+	prefix template class T<Cie1976>; \
+	prefix template class T<HueDistance>; \
+	prefix template class T<RtmDistanceFloat>; \
+	prefix template class T<CieDe2000Float>; \
+	prefix template class T<Cie1976Float>; \
+	prefix template class T<HueDistanceFloat>;
+
+#define DECLARE_METRIC_TEMPLATES(T) RTP_FOR_EACH_METRIC(extern, T)
+#define INSTANTIATE_METRIC_TEMPLATES(T) RTP_FOR_EACH_METRIC(, T)
+
+#endif // METRIC_H
@@ -0,0 +1,364 @@
+#include "paletteindex.h"
+#include "colorhistogram.h"
+#include "imageview.h"
+#include "trace.h"
+
+#include <QImage>
+#include <algorithm>
+#include <cstring>
+
+static const char kMagic[8] = { 'R', 'T', 'P', 'I', 'N', 'D', 'E', 'X' };
+static const quint32 kByteOrder = 0x01020304;
+
+struct PaletteIndex::Header
+{
+	char vMagic[8];
+	quint32 iVersion;
+	quint32 iByteOrder;
+	char vDistance[64];		// name, zero padded
+	qint32 iWidth;
+	qint32 iHeight;
+	qint32 iPixels;
+	qint32 iColors;
+	quint64 iChecksum;
+	qint64 iSorted;			// section offsets from the start of the file
+	qint64 iColorList;
+	qint64 iStart;
+	qint64 iIndices;
+	qint64 iKeys;
+	qint64 iOrder;
+	qint64 iSize;			// of the whole file
+};
+
+static qint64 aligned(qint64 bytes)
+{
+	return (bytes + 7) & ~qint64(7);
+}
+
+// The palette in the 32 bit format IAlgorithm::setup gives it, whose pixel
+// values are the same whichever of the two the input makes it pick.
+static QImage palette32(const QImage *img)
+{
+	return img->convertToFormat(img->hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+}
+
+// Whether values holds every number of [0, n) once.
+static bool isPermutation(const int *values, int n)
+{
+	QVector<bool> seen(n);
+	for (int i = 0; i < n; i++)
+	{
+		auto v = values[i];
+		if (v < 0 || v >= n || seen[v])
+			return false;
+
+		seen[v] = true;
+	}
+
+	return true;
+}
+
+PaletteIndex::PaletteIndex()
+	: mFile()
+	, pData(nullptr)
+	, iSize(0)
+	, sError()
+{
+}
+
+bool PaletteIndex::create(const QString &path, const QImage *palette, const QString &distance, ColorKeysFunction keys)
+{
+	TraceScope trace("createPaletteIndex");
+	clear();
+
+	auto img = palette32(palette);
+	Counters counters;
+	auto sorted = createPixelList(&img, kSortedColor, keys, counters);
+
+	ColorHistogram hist;
+	hist.build(&img);
+
+	QVector<double> colorKey(hist.size());
+	keys(hist.colors(), colorKey.data());
+
+	QVector<int> order(hist.size());
+	for (int c = 0; c < order.size(); c++)
+		order[c] = c;
+
+	std::stable_sort(order.begin(), order.end(), [&colorKey](int a, int b)
+	{
+		return colorKey[a] < colorKey[b];
+	});
+
+	QVector<int> start(hist.size() + 1);
+	start[0] = 0;
+	for (int c = 0; c < hist.size(); c++)
+		start[c + 1] = start[c] + hist.count(c);
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.vMagic, kMagic, sizeof(kMagic));
+	h.iVersion = kVersion;
+	h.iByteOrder = kByteOrder;
+
+	auto name = distance.toUtf8();
+	std::memcpy(h.vDistance, name.constData(), std::min(size_t(name.size()), sizeof(h.vDistance) - 1));
+
+	h.iWidth = img.width();
+	h.iHeight = img.height();
+	h.iPixels = sorted.size();
+	h.iColors = hist.size();
+	h.iChecksum = checksum(&img);
+
+	qint64 offset = aligned(sizeof(Header));
+	auto place = [&offset](qint64 bytes)
+	{
+		auto at = offset;
+		offset += aligned(bytes);
+		return at;
+	};
+
+	h.iSorted = place(qint64(h.iPixels) * sizeof(SortedPixel));
+	h.iColorList = place(qint64(h.iColors) * sizeof(Pixel));
+	h.iStart = place(qint64(h.iColors + 1) * sizeof(int));
+	h.iIndices = place(qint64(h.iPixels) * sizeof(int));
+	h.iKeys = place(qint64(h.iColors) * sizeof(double));
+	h.iOrder = place(qint64(h.iColors) * sizeof(int));
+	h.iSize = offset;
+
+	QFile file(path);
+	auto ok = file.open(QIODevice::WriteOnly);
+
+	auto write = [&file, &ok](const void *data, qint64 bytes)
+	{
+		static const char kPadding[8] = {};
+		ok = ok && file.write(static_cast<const char *>(data), bytes) == bytes;
+		ok = ok && file.write(kPadding, aligned(bytes) - bytes) == aligned(bytes) - bytes;
+	};
+
+	write(&h, sizeof(h));
+	write(sorted.constData(), qint64(h.iPixels) * sizeof(SortedPixel));
+	write(hist.colors().constData(), qint64(h.iColors) * sizeof(Pixel));
+	write(start.constData(), qint64(h.iColors + 1) * sizeof(int));
+	write(hist.indices(0), qint64(h.iPixels) * sizeof(int));
+	write(colorKey.constData(), qint64(h.iColors) * sizeof(double));
+	write(order.constData(), qint64(h.iColors) * sizeof(int));
+	ok = ok && file.flush();
+	file.close();
+
+	if (!ok)
+	{
+		file.remove();
+		sError = QString("Could not write %1").arg(path);
+		return false;
+	}
+
+	return load(path);
+}
+
+bool PaletteIndex::load(const QString &path)
+{
+	TraceScope trace("loadPaletteIndex");
+	clear();
+
+	mFile.setFileName(path);
+	if (!mFile.open(QIODevice::ReadOnly))
+	{
+		sError = QString("Could not open %1").arg(path);
+		return false;
+	}
+
+	iSize = mFile.size();
+	pData = iSize >= qint64(sizeof(Header)) ? mFile.map(0, iSize) : nullptr;
+
+	if (!validate(path))
+	{
+		auto error = sError;
+		clear();
+		sError = error;
+		return false;
+	}
+
+	return true;
+}
+
+bool PaletteIndex::validate(const QString &path)
+{
+	sError = QString("%1 is not a palette index or is damaged").arg(path);
+
+	auto h = header();
+	if (!h || std::memcmp(h->vMagic, kMagic, sizeof(kMagic)) != 0)
+		return false;
+
+	if (h->iByteOrder != kByteOrder || h->iVersion != kVersion)
+	{
+		sError = QString("%1 was written by another version or on another machine").arg(path);
+		return false;
+	}
+
+	if (h->iSize != iSize || h->iWidth < 0 || h->iHeight < 0 || h->iColors < 0
+		|| qint64(h->iWidth) * h->iHeight != h->iPixels || h->iColors > h->iPixels
+		|| h->vDistance[sizeof(h->vDistance) - 1] != 0)
+		return false;
+
+	auto fits = [this](qint64 offset, qint64 bytes)
+	{
+		return offset >= qint64(sizeof(Header)) && offset % 8 == 0 && bytes >= 0 && offset + bytes <= iSize;
+	};
+
+	if (!fits(h->iSorted, qint64(h->iPixels) * sizeof(SortedPixel))
+		|| !fits(h->iColorList, qint64(h->iColors) * sizeof(Pixel))
+		|| !fits(h->iStart, qint64(h->iColors + 1) * sizeof(int))
+		|| !fits(h->iIndices, qint64(h->iPixels) * sizeof(int))
+		|| !fits(h->iKeys, qint64(h->iColors) * sizeof(double))
+		|| !fits(h->iOrder, qint64(h->iColors) * sizeof(int)))
+		return false;
+
+	// the histogram offsets must cover the pixels, in order
+	auto start = section<int>(h->iStart);
+	for (int c = 0; c < h->iColors; c++)
+	{
+		if (start[c] > start[c + 1])
+			return false;
+	}
+
+	if (start[0] != 0 || start[h->iColors] != h->iPixels)
+		return false;
+
+	// the techniques write through the pixel indices and read through the
+	// color order, both must be permutations
+	if (!isPermutation(section<int>(h->iIndices), h->iPixels) || !isPermutation(section<int>(h->iOrder), h->iColors))
+		return false;
+
+	// keys defined and ascending, in both sorted orders
+	auto sorted = section<SortedPixel>(h->iSorted);
+	for (int i = 0; i < h->iPixels; i++)
+	{
+		if (sorted[i].fD != sorted[i].fD || (i > 0 && sorted[i].fD < sorted[i - 1].fD))
+			return false;
+	}
+
+	auto keys = section<double>(h->iKeys);
+	auto order = section<int>(h->iOrder);
+	for (int i = 0; i < h->iColors; i++)
+	{
+		auto key = keys[order[i]];
+		if (key != key || (i > 0 && key < keys[order[i - 1]]))
+			return false;
+	}
+
+	sError.clear();
+	return true;
+}
+
+void PaletteIndex::clear()
+{
+	if (pData)
+		mFile.unmap(const_cast<uchar *>(pData));
+
+	mFile.close();
+	pData = nullptr;
+	iSize = 0;
+	sError.clear();
+}
+
+bool PaletteIndex::matches(const QImage *palette, const QString &distance) const
+{
+	if (isEmpty() || this->distance() != distance)
+		return false;
+
+	if (palette->width() != width() || palette->height() != height())
+		return false;
+
+	auto img = palette32(palette);
+	if (checksum(&img) != header()->iChecksum)
+		return false;
+
+	// every histogram color is the color of its pixels, which validate()
+	// cannot tell without the palette
+	auto h = header();
+	auto view = constImageView(&img);
+	auto colors = section<Pixel>(h->iColorList);
+	auto start = section<int>(h->iStart);
+	auto indices = section<int>(h->iIndices);
+	for (int c = 0; c < h->iColors; c++)
+	{
+		for (int i = start[c]; i < start[c + 1]; i++)
+		{
+			if (view.at(indices[i]) != colors[c].c)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+QString PaletteIndex::distance() const
+{
+	return isEmpty() ? QString() : QString::fromUtf8(header()->vDistance);
+}
+
+int PaletteIndex::width() const
+{
+	return isEmpty() ? 0 : header()->iWidth;
+}
+
+int PaletteIndex::height() const
+{
+	return isEmpty() ? 0 : header()->iHeight;
+}
+
+int PaletteIndex::pixels() const
+{
+	return isEmpty() ? 0 : header()->iPixels;
+}
+
+int PaletteIndex::colors() const
+{
+	return isEmpty() ? 0 : header()->iColors;
+}
+
+QVector<SortedPixel> PaletteIndex::sortedPixels() const
+{
+	QVector<SortedPixel> list(pixels());
+	if (!list.isEmpty())
+		std::memcpy(list.data(), section<SortedPixel>(header()->iSorted), list.size() * sizeof(SortedPixel));
+
+	Counters::count(Counters::kCounterBytesAllocated, qint64(list.size()) * sizeof(SortedPixel));
+	return list;
+}
+
+void PaletteIndex::histogram(ColorHistogram &out) const
+{
+	auto h = header();
+	out.assign(section<Pixel>(h->iColorList), h->iColors, section<int>(h->iStart), section<int>(h->iIndices));
+}
+
+const double *PaletteIndex::colorKeys() const
+{
+	return section<double>(header()->iKeys);
+}
+
+const int *PaletteIndex::colorOrder() const
+{
+	return section<int>(header()->iOrder);
+}
+
+const PaletteIndex::Header *PaletteIndex::header() const
+{
+	return reinterpret_cast<const Header *>(pData);
+}
+
+quint64 PaletteIndex::checksum(const QImage *img)
+{
+	auto view = constImageView(img);
+
+	quint64 h = 14695981039346656037ull;
+	for (int i = 0, n = view.count(); i < n; i++)
+	{
+		h ^= view.at(i);
+		h *= 1099511628211ull;
+	}
+
+	return h;
+}
@@ -0,0 +1,89 @@
+#ifndef PALETTEINDEX_H
+#define PALETTEINDEX_H
+
+#include "pixellist.h"
+#include "metric.h"
+#include <QVector>
+#include <QFile>
+#include <QString>
+
+class QImage;
+class ColorHistogram;
+
+// What the techniques derive from a palette alone for one distance, saved to
+// a binary file that is mapped back instead of computed again when the same
+// palette is applied to many inputs:
+//   - the palette pixels by ascending key with their color, the sorted list
+//     of AlgorithmSortBase
+//   - the color histogram, as ColorHistogram::build makes it
+//   - the key of every histogram color and the colors by ascending key
+//
+// The file is a header followed by the sections as raw arrays, 8 byte
+// aligned, in the byte order of the machine that wrote it. Loading maps it and
+// checks the version, byte order, bounds and the indices and keys inside the
+// sections, matches() the colors against the palette. Techniques then only
+// copy the sections out.
+class PaletteIndex
+{
+	public:
+		static const quint32 kVersion = 1;
+
+		PaletteIndex();
+
+		// Computes the index of palette for a distance named as in
+		// distanceList(), whose keys are keys, writes it to path and maps it.
+		bool create(const QString &path, const QImage *palette, const QString &distance, ColorKeysFunction keys);
+
+		// Maps a saved index. Fails on files of another version or byte
+		// order and on damaged ones, see errorString().
+		bool load(const QString &path);
+		void clear();
+
+		bool isEmpty() const
+		{
+			return pData == nullptr;
+		}
+
+		// Whether the index was built from these pixels with this distance.
+		bool matches(const QImage *palette, const QString &distance) const;
+
+		QString distance() const;
+		int width() const;
+		int height() const;
+		int pixels() const;
+		int colors() const;
+
+		QVector<SortedPixel> sortedPixels() const;
+		void histogram(ColorHistogram &out) const;
+
+		// Key of each histogram color, and histogram colors by ascending key.
+		const double *colorKeys() const;
+		const int *colorOrder() const;
+
+		QString errorString() const
+		{
+			return sError;
+		}
+
+	private:
+		struct Header;
+
+		const Header *header() const;
+		bool validate(const QString &path);
+
+		template <class T>
+		const T *section(qint64 offset) const
+		{
+			return reinterpret_cast<const T *>(pData + offset);
+		}
+
+		// FNV-1a over the 32 bit pixels, see imageview.h.
+		static quint64 checksum(const QImage *img);
+
+		QFile mFile;
+		const uchar *pData;
+		qint64 iSize;
+		QString sError;
+};
+
+#endif // PALETTEINDEX_H
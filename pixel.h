@@ -1,317 +1,380 @@
-#ifndef PIXEL_H
-#define PIXEL_H
-
-#include <math.h>
-#include <algorithm>
-#include <QColor>
-
-union PixelNormalized
-{
-	struct
-	{
-		double L;
-		double a;
-		double b;
-	};
-	struct
-	{
-		double x;
-		double y;
-		double z;
-	};
-	struct
-	{
-		double r;
-		double g;
-		double blue;
-	};
-	struct
-	{
-		double h;
-		double s;
-		double v;
-	};
-};
-
-union Pixel
-{
-	unsigned int c;
-	struct
-	{
-		unsigned char r;
-		unsigned char g;
-		unsigned char b;
-		unsigned char a;
-	};
-
-	Pixel() : c(0) {}
-	Pixel(int v) : c(v) {}
-};
-
-static const Pixel empty;
-
-
-static const double kWhiteReferenceX = 95.047f;
-static const double kWhiteReferenceY = 100.f;
-static const double kWhiteReferenceZ = 108.883f;
-
-#if defined(_MSC_VER)
-static const double kXyzEpsilon = double(216 / 24389.f);
-static const double kXyzKappa = double(24389 / 27.f);
-static const double kPi = double(3.14159265358979323846);
-
-#define PivotRGB(n)		((n > 0.04045 ? pow((n + 0.055) / 1.055, 2.4) : n / 12.92) * 100.0)
-#define PivotXYZ(n)		((n > kXyzEpsilon ? pow(n, 1 / 3.f) : (kXyzKappa * n + 16) / 116))
-#define DegToRad(d)		((d * kPi / 180.f))
-#define Distance(a, b)	((a - b) * (a - b))
-#else
-static constexpr double kXyzEpsilon = double(216 / 24389.f);
-static constexpr double kXyzKappa = double(24389 / 27.f);
-static constexpr double kPi = double(3.14159265358979323846);
-
-constexpr double PivotRGB(double n) { return ((n > 0.04045 ? pow((n + 0.055) / 1.055, 2.4) : n / 12.92) * 100.0); }
-constexpr double PivotXYZ(double n) { return ((n > kXyzEpsilon ? pow(n, 1 / 3.f) : (kXyzKappa * n + 16) / 116)); }
-constexpr double DegToRad(double d) { return d * kPi / 180.f; }
-constexpr double Distance(double a, double b) { return (a - b) * (a - b); }
-#endif
-
-inline PixelNormalized RGBtoHSV(Pixel p)
-{
-	PixelNormalized r, i;
-
-	// pre-cast for comparissions
-	i.r = double(p.r);
-	i.g = double(p.g);
-	i.b = double(p.b);
-
-	auto max = double(std::max<unsigned char>(p.r, std::max<unsigned char>(p.g, p.b)));
-	auto min = double(std::min<unsigned char>(p.r, std::min<unsigned char>(p.g, p.b)));
-
-	r.v = max;
-	auto delta = max - min;
-
-	if (max > 0.0f)
-	{
-		r.s = delta / max * 255;
-	}
-	else
-	{
-		r.s = 0.0f;
-		r.h = 0.0f;
-		return r;
-	}
-
-	if		(i.r >= max) r.h =		 (i.g - i.b) / delta;
-	else if (i.g >= max) r.h = 2.0 + (i.b - i.r) / delta;
-	else				 r.h = 4.0 + (i.r - i.g) / delta;
-
-	r.h *= 60.0;
-	if (r.h < 0.0)
-		r.h += 360.0;
-
-	return r;
-}
-
-inline PixelNormalized RGBtoXYZ(Pixel p)
-{
-	auto r = PivotRGB(p.r / 255.f);
-	auto g = PivotRGB(p.g / 255.f);
-	auto b = PivotRGB(p.b / 255.f);
-
-	PixelNormalized n;
-	n.x = r * 0.412453f + g * 0.357580f + b * 0.180423f;
-	n.y = r * 0.212671f + g * 0.715160f + b * 0.072169f;
-	n.z = r * 0.019334f + g * 0.119193f + b * 0.950227f;
-
-	return std::move(n);
-}
-
-inline PixelNormalized XYZtoLAB(PixelNormalized p)
-{
-	auto x = PivotXYZ(p.x / kWhiteReferenceX);
-	auto y = PivotXYZ(p.y / kWhiteReferenceY);
-	auto z = PivotXYZ(p.z / kWhiteReferenceZ);
-
-	PixelNormalized n;
-	n.L = std::max<double>(0.f, 116.f * y - 16.f);
-	n.a = 500.f * (x - y);
-	n.b = 200.f * (y - z);
-
-	return std::move(n);
-}
-
-inline PixelNormalized RGBtoLAB(Pixel p)
-{
-	return XYZtoLAB(RGBtoXYZ(p));
-}
-
-// https://github.com/THEjoezack/ColorMine/blob/master/ColorMine/ColorSpaces/Comparisons/CieDe2000Comparison.cs
-inline double ciede2000(Pixel p1, Pixel p2 = empty)
-{
-	//Set weighting factors to 1
-	double k_L = 1.0f;
-	double k_C = 1.0f;
-	double k_H = 1.0f;
-
-	//Change Color Space to L*a*b:
-	auto lab1 = RGBtoLAB(p1);
-	auto lab2 = RGBtoLAB(p2);
-
-	//Calculate Cprime1, Cprime2, Cabbar
-	double c_star_1_ab = sqrt(lab1.a * lab1.a + lab1.b * lab1.b);
-	double c_star_2_ab = sqrt(lab2.a * lab2.a + lab2.b * lab2.b);
-	double c_star_average_ab = (c_star_1_ab + c_star_2_ab) / 2.f;
-
-	double c_star_average_ab_pot7 = c_star_average_ab * c_star_average_ab * c_star_average_ab;
-	c_star_average_ab_pot7 *= c_star_average_ab_pot7 * c_star_average_ab;
-
-	double G = 0.5f * (1 - sqrt(c_star_average_ab_pot7 / (c_star_average_ab_pot7 + 6103515625))); //25^7
-	double a1_prime = (1 + G) * lab1.a;
-	double a2_prime = (1 + G) * lab2.a;
-
-	double C_prime_1 = sqrt(a1_prime * a1_prime + lab1.b * lab1.b);
-	double C_prime_2 = sqrt(a2_prime * a2_prime + lab2.b * lab2.b);
-	//Angles in Degree.
-	double h_prime_1 = fmod(((atan2(lab1.b, a1_prime) * 180.f / kPi) + 360.f), 360.f);
-	double h_prime_2 = fmod(((atan2(lab2.b, a2_prime) * 180.f / kPi) + 360.f), 360.f);
-
-	double delta_L_prime = lab2.L - lab1.L;
-	double delta_C_prime = C_prime_2 - C_prime_1;
-
-	double h_bar = std::abs(double(h_prime_1 - h_prime_2));
-	double delta_h_prime;
-
-	if (C_prime_1 * C_prime_2 == 0)
-		delta_h_prime = 0;
-	else
-	{
-		if (h_bar <= 180.f)
-		{
-			delta_h_prime = h_prime_2 - h_prime_1;
-		}
-		else if (h_bar > 180.f && h_prime_2 <= h_prime_1)
-		{
-			delta_h_prime = h_prime_2 - h_prime_1 + 360.f;
-		}
-		else
-		{
-			delta_h_prime = h_prime_2 - h_prime_1 - 360.f;
-		}
-	}
-	double delta_H_prime = 2 * sqrt(C_prime_1 * C_prime_2) * sin(delta_h_prime * kPi / 360.f);
-
-	// Calculate CIEDE2000
-	double L_prime_average = (lab1.L + lab2.L) / 2.f;
-	double C_prime_average = (C_prime_1 + C_prime_2) / 2.f;
-
-	//Calculate h_prime_average
-
-	double h_prime_average;
-	if (C_prime_1 * C_prime_2 == 0)
-		h_prime_average = 0;
-	else
-	{
-		if (h_bar <= 180.f)
-		{
-			h_prime_average = (h_prime_1 + h_prime_2) / 2.f;
-		}
-		else if (h_bar > 180.f && (h_prime_1 + h_prime_2) < 360.f)
-		{
-			h_prime_average = (h_prime_1 + h_prime_2 + 360.f) / 2.f;
-		}
-		else
-		{
-			h_prime_average = (h_prime_1 + h_prime_2 - 360.f) / 2.f;
-		}
-	}
-	double L_prime_average_minus_50_square = (L_prime_average - 50);
-	L_prime_average_minus_50_square *= L_prime_average_minus_50_square;
-
-	double S_L = 1 + ((.015f * L_prime_average_minus_50_square) / sqrt(20 + L_prime_average_minus_50_square));
-	double S_C = 1 + .045f * C_prime_average;
-	double T = 1
-		- .17f * cos(DegToRad(h_prime_average - 30))
-		+ .24f * cos(DegToRad(h_prime_average * 2))
-		+ .32f * cos(DegToRad(h_prime_average * 3 + 6))
-		- .2f  * cos(DegToRad(h_prime_average * 4 - 63));
-
-	double S_H = 1 + .015f * T * C_prime_average;
-	double h_prime_average_minus_275_div_25_square = (h_prime_average - 275) / 25.f;
-	h_prime_average_minus_275_div_25_square *= h_prime_average_minus_275_div_25_square;
-	double delta_theta = 30.f * exp(-h_prime_average_minus_275_div_25_square);
-
-	double C_prime_average_pot_7 = C_prime_average * C_prime_average * C_prime_average;
-	C_prime_average_pot_7 *= C_prime_average_pot_7 * C_prime_average;
-	double R_C = 2 * sqrt(C_prime_average_pot_7 / (C_prime_average_pot_7 + 6103515625));
-
-	double R_T = -sin(DegToRad(2 * delta_theta)) * R_C;
-
-	double delta_L_prime_div_k_L_S_L = delta_L_prime / (S_L * k_L);
-	double delta_C_prime_div_k_C_S_C = delta_C_prime / (S_C * k_C);
-	double delta_H_prime_div_k_H_S_H = delta_H_prime / (S_H * k_H);
-
-	double CIEDE2000 = sqrt(
-		  delta_L_prime_div_k_L_S_L * delta_L_prime_div_k_L_S_L
-		+ delta_C_prime_div_k_C_S_C * delta_C_prime_div_k_C_S_C
-		+ delta_H_prime_div_k_H_S_H * delta_H_prime_div_k_H_S_H
-		+ R_T * delta_C_prime_div_k_C_S_C * delta_H_prime_div_k_H_S_H
-		);
-
-	return CIEDE2000;
-}
-
-inline double cie1976(Pixel p1, Pixel p2 = empty)
-{
-	//Change Color Space to L*a*b:
-	auto a = RGBtoLAB(p1);
-	auto b = RGBtoLAB(p2);
-
-	auto differences = Distance(a.L, b.L) + Distance(a.a, b.a) + Distance(a.b, b.b);
-	return differences;
-	//return sqrt(differences);
-}
-
-// http://www.compuphase.com/cmetric.htm
-inline double cmetric(Pixel p1, Pixel p2 = empty)
-{
-	long rmean = ((long)p1.r + (long)p2.r) / 2.f;
-	long r = (long)p1.r - (long)p2.r;
-	long g = (long)p1.g - (long)p2.g;
-	long b = (long)p1.b - (long)p2.b;
-	return (((512 + rmean) * r * r) >> 8) + (4 * g * g) + (((767 - rmean) * b * b) >> 8);
-}
-
-inline double rtm_distance(Pixel p1, Pixel p2 = empty)
-{
-	static double f[] = {0.114, 0.587, 0.299};
-	static const int kWeight = 10;
-
-	double x[3] = {p1.r * f[0], p1.g * f[1], p1.b * f[2]};
-	double y[3] = {p2.r * f[0], p2.g * f[1], p2.b * f[2]};
-	double t = 0;
-	double lx = 0;
-	double ly = 0;
-
-	for (int i = 0; i < 3; ++i)
-	{
-		double xi = x[i];
-		double yi = y[i];
-		double d = xi - yi;
-
-		t += d * d;
-		lx += xi;
-		ly += yi;
-	}
-
-	double l = lx - ly;
-	return t + l * l * kWeight;
-}
-
-inline double hue_distance(Pixel p1, Pixel p2 = empty)
-{
-	auto h1 = RGBtoHSV(p1);
-	auto h2 = RGBtoHSV(p2);
-	return std::abs(double(h2.h - h1.h));
-}
-
-#endif // PIXEL_H
+#ifndef PIXEL_H
+#define PIXEL_H
+
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <QColor>
+
+// Converted color coordinates, in double or float: T is the scalar type every
+// conversion and formula below computes in. 8 bit channels fit in a float
+// with room to spare, the double forms are the reference.
+template <class T>
+union PixelNormalizedT
+{
+	struct
+	{
+		T L;
+		T a;
+		T b;
+	};
+	struct
+	{
+		T x;
+		T y;
+		T z;
+	};
+	struct
+	{
+		T r;
+		T g;
+		T blue;
+	};
+	struct
+	{
+		T h;
+		T s;
+		T v;
+	};
+};
+
+typedef PixelNormalizedT<double> PixelNormalized;
+typedef PixelNormalizedT<float> PixelNormalizedF;
+
+// Same coordinates in another scalar type.
+template <class T, class U>
+inline PixelNormalizedT<T> normalizedCast(const PixelNormalizedT<U> &p)
+{
+	PixelNormalizedT<T> n;
+	n.x = T(p.x);
+	n.y = T(p.y);
+	n.z = T(p.z);
+	return n;
+}
+
+union Pixel
+{
+	unsigned int c;
+	struct
+	{
+		unsigned char r;
+		unsigned char g;
+		unsigned char b;
+		unsigned char a;
+	};
+
+	Pixel() : c(0) {}
+	Pixel(int v) : c(v) {}
+};
+
+static const Pixel empty;
+
+// Color space a distance formula works in, used to pre-convert images once.
+enum ColorSpace
+{
+	kColorSpaceRGB,
+	kColorSpaceXYZ,
+	kColorSpaceLab,
+	kColorSpaceHSV
+};
+
+
+static const double kWhiteReferenceX = 95.047f;
+static const double kWhiteReferenceY = 100.f;
+static const double kWhiteReferenceZ = 108.883f;
+
+#if defined(_MSC_VER)
+static const double kXyzEpsilon = double(216 / 24389.f);
+static const double kXyzKappa = double(24389 / 27.f);
+static const double kPi = double(3.14159265358979323846);
+#else
+static constexpr double kXyzEpsilon = double(216 / 24389.f);
+static constexpr double kXyzKappa = double(24389 / 27.f);
+static constexpr double kPi = double(3.14159265358979323846);
+#endif
+
+template <class T>
+inline T PivotRGB(T n) { return ((n > T(0.04045) ? std::pow((n + T(0.055)) / T(1.055), T(2.4)) : n / T(12.92)) * T(100.0)); }
+template <class T>
+inline T PivotXYZ(T n) { return ((n > T(kXyzEpsilon) ? std::pow(n, T(1 / 3.f)) : (T(kXyzKappa) * n + 16) / 116)); }
+template <class T>
+inline T DegToRad(T d) { return d * T(kPi) / 180.f; }
+template <class T>
+inline T Distance(T a, T b) { return (a - b) * (a - b); }
+
+template <class T = double>
+inline PixelNormalizedT<T> RGBtoHSV(Pixel p)
+{
+	PixelNormalizedT<T> r, i;
+
+	// pre-cast for comparissions
+	i.r = T(p.r);
+	i.g = T(p.g);
+	i.b = T(p.b);
+
+	auto max = T(std::max<unsigned char>(p.r, std::max<unsigned char>(p.g, p.b)));
+	auto min = T(std::min<unsigned char>(p.r, std::min<unsigned char>(p.g, p.b)));
+
+	r.v = max;
+	auto delta = max - min;
+
+	if (max > 0.0f)
+	{
+		r.s = delta / max * 255;
+	}
+	else
+	{
+		r.s = 0.0f;
+		r.h = 0.0f;
+		return r;
+	}
+
+	if		(i.r >= max) r.h =		   (i.g - i.b) / delta;
+	else if (i.g >= max) r.h = T(2.0) + (i.b - i.r) / delta;
+	else				 r.h = T(4.0) + (i.r - i.g) / delta;
+
+	r.h *= T(60.0);
+	if (r.h < T(0.0))
+		r.h += T(360.0);
+
+	return r;
+}
+
+template <class T = double>
+inline PixelNormalizedT<T> RGBtoXYZ(Pixel p)
+{
+	auto r = PivotRGB(T(p.r / 255.f));
+	auto g = PivotRGB(T(p.g / 255.f));
+	auto b = PivotRGB(T(p.b / 255.f));
+
+	PixelNormalizedT<T> n;
+	n.x = r * 0.412453f + g * 0.357580f + b * 0.180423f;
+	n.y = r * 0.212671f + g * 0.715160f + b * 0.072169f;
+	n.z = r * 0.019334f + g * 0.119193f + b * 0.950227f;
+
+	return std::move(n);
+}
+
+template <class T>
+inline PixelNormalizedT<T> XYZtoLAB(PixelNormalizedT<T> p)
+{
+	auto x = PivotXYZ(p.x / T(kWhiteReferenceX));
+	auto y = PivotXYZ(p.y / T(kWhiteReferenceY));
+	auto z = PivotXYZ(p.z / T(kWhiteReferenceZ));
+
+	PixelNormalizedT<T> n;
+	n.L = std::max<T>(0.f, 116.f * y - 16.f);
+	n.a = 500.f * (x - y);
+	n.b = 200.f * (y - z);
+
+	return std::move(n);
+}
+
+template <class T = double>
+inline PixelNormalizedT<T> RGBtoLAB(Pixel p)
+{
+	return XYZtoLAB(RGBtoXYZ<T>(p));
+}
+
+template <class T = double>
+inline PixelNormalizedT<T> RGBtoColorSpace(Pixel p, ColorSpace space)
+{
+	switch (space)
+	{
+		case kColorSpaceXYZ: return RGBtoXYZ<T>(p);
+		case kColorSpaceLab: return RGBtoLAB<T>(p);
+		case kColorSpaceHSV: return RGBtoHSV<T>(p);
+		default: break;
+	}
+
+	PixelNormalizedT<T> n;
+	n.r = T(p.r);
+	n.g = T(p.g);
+	n.blue = T(p.b);
+	return n;
+}
+
+// https://github.com/THEjoezack/ColorMine/blob/master/ColorMine/ColorSpaces/Comparisons/CieDe2000Comparison.cs
+template <class T>
+inline T ciede2000_lab(const PixelNormalizedT<T> &lab1, const PixelNormalizedT<T> &lab2)
+{
+	//Set weighting factors to 1
+	T k_L = 1.0f;
+	T k_C = 1.0f;
+	T k_H = 1.0f;
+
+	//Calculate Cprime1, Cprime2, Cabbar
+	T c_star_1_ab = std::sqrt(lab1.a * lab1.a + lab1.b * lab1.b);
+	T c_star_2_ab = std::sqrt(lab2.a * lab2.a + lab2.b * lab2.b);
+	T c_star_average_ab = (c_star_1_ab + c_star_2_ab) / 2.f;
+
+	T c_star_average_ab_pot7 = c_star_average_ab * c_star_average_ab * c_star_average_ab;
+	c_star_average_ab_pot7 *= c_star_average_ab_pot7 * c_star_average_ab;
+
+	T G = 0.5f * (1 - std::sqrt(c_star_average_ab_pot7 / (c_star_average_ab_pot7 + T(6103515625)))); //25^7
+	T a1_prime = (1 + G) * lab1.a;
+	T a2_prime = (1 + G) * lab2.a;
+
+	T C_prime_1 = std::sqrt(a1_prime * a1_prime + lab1.b * lab1.b);
+	T C_prime_2 = std::sqrt(a2_prime * a2_prime + lab2.b * lab2.b);
+	//Angles in Degree.
+	T h_prime_1 = std::fmod(((std::atan2(lab1.b, a1_prime) * 180.f / T(kPi)) + 360.f), T(360.f));
+	T h_prime_2 = std::fmod(((std::atan2(lab2.b, a2_prime) * 180.f / T(kPi)) + 360.f), T(360.f));
+
+	T delta_L_prime = lab2.L - lab1.L;
+	T delta_C_prime = C_prime_2 - C_prime_1;
+
+	T h_bar = std::abs(T(h_prime_1 - h_prime_2));
+	T delta_h_prime;
+
+	if (C_prime_1 * C_prime_2 == 0)
+		delta_h_prime = 0;
+	else
+	{
+		if (h_bar <= 180.f)
+		{
+			delta_h_prime = h_prime_2 - h_prime_1;
+		}
+		else if (h_bar > 180.f && h_prime_2 <= h_prime_1)
+		{
+			delta_h_prime = h_prime_2 - h_prime_1 + 360.f;
+		}
+		else
+		{
+			delta_h_prime = h_prime_2 - h_prime_1 - 360.f;
+		}
+	}
+	T delta_H_prime = 2 * std::sqrt(C_prime_1 * C_prime_2) * std::sin(delta_h_prime * T(kPi) / 360.f);
+
+	// Calculate CIEDE2000
+	T L_prime_average = (lab1.L + lab2.L) / 2.f;
+	T C_prime_average = (C_prime_1 + C_prime_2) / 2.f;
+
+	//Calculate h_prime_average
+
+	T h_prime_average;
+	if (C_prime_1 * C_prime_2 == 0)
+		h_prime_average = 0;
+	else
+	{
+		if (h_bar <= 180.f)
+		{
+			h_prime_average = (h_prime_1 + h_prime_2) / 2.f;
+		}
+		else if (h_bar > 180.f && (h_prime_1 + h_prime_2) < 360.f)
+		{
+			h_prime_average = (h_prime_1 + h_prime_2 + 360.f) / 2.f;
+		}
+		else
+		{
+			h_prime_average = (h_prime_1 + h_prime_2 - 360.f) / 2.f;
+		}
+	}
+	T L_prime_average_minus_50_square = (L_prime_average - 50);
+	L_prime_average_minus_50_square *= L_prime_average_minus_50_square;
+
+	T S_L = 1 + ((.015f * L_prime_average_minus_50_square) / std::sqrt(20 + L_prime_average_minus_50_square));
+	T S_C = 1 + .045f * C_prime_average;
+	T T_hue = 1
+		- .17f * std::cos(DegToRad<T>(h_prime_average - 30))
+		+ .24f * std::cos(DegToRad<T>(h_prime_average * 2))
+		+ .32f * std::cos(DegToRad<T>(h_prime_average * 3 + 6))
+		- .2f  * std::cos(DegToRad<T>(h_prime_average * 4 - 63));
+
+	T S_H = 1 + .015f * T_hue * C_prime_average;
+	T h_prime_average_minus_275_div_25_square = (h_prime_average - 275) / 25.f;
+	h_prime_average_minus_275_div_25_square *= h_prime_average_minus_275_div_25_square;
+	T delta_theta = 30.f * std::exp(-h_prime_average_minus_275_div_25_square);
+
+	T C_prime_average_pot_7 = C_prime_average * C_prime_average * C_prime_average;
+	C_prime_average_pot_7 *= C_prime_average_pot_7 * C_prime_average;
+	T R_C = 2 * std::sqrt(C_prime_average_pot_7 / (C_prime_average_pot_7 + T(6103515625)));
+
+	T R_T = -std::sin(DegToRad<T>(2 * delta_theta)) * R_C;
+
+	T delta_L_prime_div_k_L_S_L = delta_L_prime / (S_L * k_L);
+	T delta_C_prime_div_k_C_S_C = delta_C_prime / (S_C * k_C);
+	T delta_H_prime_div_k_H_S_H = delta_H_prime / (S_H * k_H);
+
+	T CIEDE2000 = std::sqrt(
+		  delta_L_prime_div_k_L_S_L * delta_L_prime_div_k_L_S_L
+		+ delta_C_prime_div_k_C_S_C * delta_C_prime_div_k_C_S_C
+		+ delta_H_prime_div_k_H_S_H * delta_H_prime_div_k_H_S_H
+		+ R_T * delta_C_prime_div_k_C_S_C * delta_H_prime_div_k_H_S_H
+		);
+
+	return CIEDE2000;
+}
+
+template <class T = double>
+inline T ciede2000(Pixel p1, Pixel p2 = empty)
+{
+	//Change Color Space to L*a*b:
+	return ciede2000_lab(RGBtoLAB<T>(p1), RGBtoLAB<T>(p2));
+}
+
+template <class T>
+inline T cie1976_lab(const PixelNormalizedT<T> &a, const PixelNormalizedT<T> &b)
+{
+	auto differences = Distance(a.L, b.L) + Distance(a.a, b.a) + Distance(a.b, b.b);
+	return differences;
+	//return sqrt(differences);
+}
+
+template <class T = double>
+inline T cie1976(Pixel p1, Pixel p2 = empty)
+{
+	//Change Color Space to L*a*b:
+	return cie1976_lab(RGBtoLAB<T>(p1), RGBtoLAB<T>(p2));
+}
+
+// http://www.compuphase.com/cmetric.htm
+inline double cmetric(Pixel p1, Pixel p2 = empty)
+{
+	long rmean = ((long)p1.r + (long)p2.r) / 2.f;
+	long r = (long)p1.r - (long)p2.r;
+	long g = (long)p1.g - (long)p2.g;
+	long b = (long)p1.b - (long)p2.b;
+	return (((512 + rmean) * r * r) >> 8) + (4 * g * g) + (((767 - rmean) * b * b) >> 8);
+}
+
+template <class T = double>
+inline T rtm_distance(Pixel p1, Pixel p2 = empty)
+{
+	static const T f[] = {T(0.114), T(0.587), T(0.299)};
+	static const int kWeight = 10;
+
+	T x[3] = {p1.r * f[0], p1.g * f[1], p1.b * f[2]};
+	T y[3] = {p2.r * f[0], p2.g * f[1], p2.b * f[2]};
+	T t = 0;
+	T lx = 0;
+	T ly = 0;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		T xi = x[i];
+		T yi = y[i];
+		T d = xi - yi;
+
+		t += d * d;
+		lx += xi;
+		ly += yi;
+	}
+
+	T l = lx - ly;
+	return t + l * l * kWeight;
+}
+
+template <class T>
+inline T hue_distance_hsv(const PixelNormalizedT<T> &h1, const PixelNormalizedT<T> &h2)
+{
+	return std::abs(T(h2.h - h1.h));
+}
+
+template <class T = double>
+inline T hue_distance(Pixel p1, Pixel p2 = empty)
+{
+	return hue_distance_hsv(RGBtoHSV<T>(p1), RGBtoHSV<T>(p2));
+}
+
+#endif // PIXEL_H
@@ -0,0 +1,110 @@
+#include "pixellist.h"
+#include "radixsort.h"
+#include "imageview.h"
+#include "trace.h"
+
+#include <QImage>
+#include <QtConcurrent/QtConcurrent>
+
+// Pixels measured per task when keys get computed.
+static const int kKeyChunk = 1 << 16;
+
+QVector<SortedPixel> createPixelList(const QImage *img, SortedValue value, ColorKeysFunction keys, Counters &counters)
+{
+	TraceScope trace("createPixelList");
+	CounterScope scope(counters, Counters::kPhaseSort);
+
+	auto view = constImageView(img);
+	auto n = view.count();
+
+	// scratch for half the list, see the sort below
+	auto half = (n + 1) / 2;
+	QVector<SortedPixel> list(n);
+	QVector<SortedPixel> scratch(half);
+	Counters::count(Counters::kCounterBytesAllocated, qint64(n + half) * sizeof(SortedPixel));
+
+	// Keys of row major chunks, each on its own thread. A chunk measures its
+	// distinct colors once, like a list of colors, since a key can take a
+	// color space conversion and more, then hands them to its pixels.
+	QVector<int> chunks((n + kKeyChunk - 1) / kKeyChunk);
+	for (int i = 0; i < chunks.size(); i++)
+		chunks[i] = i;
+
+	auto out = list.data();
+	QtConcurrent::blockingMap(chunks, [&](int &chunk)
+	{
+		CounterScope counts(counters);
+
+		auto first = chunk * kKeyChunk;
+		auto count = qMin(first + kKeyChunk, n) - first;
+
+		// open addressing, at least twice as many slots as colors
+		auto bits = 1;
+		while ((1 << bits) < 2 * count)
+			bits++;
+
+		auto mask = (1 << bits) - 1;
+		QVector<int> table(1 << bits, -1);
+		QVector<Pixel> colors;
+		QVector<int> colorOf(count);
+		colors.reserve(count);
+
+		for (int i = 0; i < count; i++)
+		{
+			auto c = view.at(first + i);
+			auto s = int((c * 0x9e3779b1u) >> (32 - bits));
+			while (table[s] >= 0 && colors[table[s]].c != c)
+				s = (s + 1) & mask;
+
+			if (table[s] < 0)
+			{
+				table[s] = colors.size();
+				colors.append(Pixel(c));
+			}
+
+			colorOf[i] = table[s];
+		}
+
+		QVector<double> colorKeys(colors.size());
+		keys(colors, colorKeys.data());
+
+		for (int i = 0; i < count; i++)
+		{
+			auto &e = out[first + i];
+			e.fD = float(colorKeys[colorOf[i]]);
+
+			if (value == kSortedIndex)
+				e.iIndex = quint32(first + i);
+			else
+				e.c = colors[colorOf[i]].c;
+		}
+	});
+
+	// Pixels with the same key stay in row major order. Each half sorts
+	// through the scratch, which then holds the second half while both merge
+	// back to front, so sorting costs half a list more instead of a whole one.
+	TraceScope sorting("radixSort");
+	auto key = [](const SortedPixel &p)
+	{
+		return radixKey(p.fD);
+	};
+
+	auto data = list.data();
+	auto rest = n - half;
+	radixSort(data, scratch.data(), half, key);
+	radixSort(data + half, scratch.data(), rest, key);
+	std::copy(data + half, data + n, scratch.data());
+
+	// ties take the second half first, since they end up later
+	auto i = half - 1;
+	auto j = rest - 1;
+	for (auto w = n - 1; j >= 0; w--)
+	{
+		if (i >= 0 && key(data[i]) > key(scratch[j]))
+			data[w] = data[i--];
+		else
+			data[w] = scratch[j--];
+	}
+
+	return list;
+}
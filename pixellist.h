@@ -0,0 +1,34 @@
+#ifndef PIXELLIST_H
+#define PIXELLIST_H
+
+#include "pixel.h"
+#include "metric.h"
+#include "counters.h"
+#include <QVector>
+
+class QImage;
+
+// Entry of a sorted pixel list, 8 bytes stored inline in a QVector. A float
+// key is plenty to order colors. Input lists keep where the pixel is, palette
+// lists its color, since pCurrent overwrites the palette image.
+struct SortedPixel
+{
+	float fD;
+	union
+	{
+		quint32 iIndex;	// y * width + x
+		QRgb c;
+	};
+};
+
+enum SortedValue
+{
+	kSortedIndex,
+	kSortedColor
+};
+
+// All pixels of img (32 bit, see imageview.h) by ascending key, with value
+// filled in. Keys and sort run on the thread pool, counts go to counters.
+QVector<SortedPixel> createPixelList(const QImage *img, SortedValue value, ColorKeysFunction keys, Counters &counters);
+
+#endif // PIXELLIST_H
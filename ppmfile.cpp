@@ -0,0 +1,149 @@
+#include "ppmfile.h"
+#include <cctype>
+
+PpmReader::PpmReader()
+	: mFile()
+	, vRow()
+	, sError()
+	, iWidth(0)
+	, iHeight(0)
+{
+}
+
+bool PpmReader::open(const QString &fileName)
+{
+	mFile.setFileName(fileName);
+	if (!mFile.open(QIODevice::ReadOnly))
+	{
+		sError = QString("Could not open %1").arg(fileName);
+		return false;
+	}
+
+	QByteArray magic, width, height, maxval;
+	if (!readToken(magic) || magic != "P6" || !readToken(width) || !readToken(height) || !readToken(maxval))
+	{
+		sError = QString("%1 is not a binary PPM (P6) file").arg(fileName);
+		return false;
+	}
+
+	iWidth = width.toInt();
+	iHeight = height.toInt();
+	if (iWidth <= 0 || iHeight <= 0 || maxval.toInt() != 255)
+	{
+		sError = QString("%1 must have a size and 8 bit channels").arg(fileName);
+		return false;
+	}
+
+	// a single whitespace byte separates the header from the pixels
+	char c;
+	if (!mFile.getChar(&c))
+	{
+		sError = QString("%1 has no pixels").arg(fileName);
+		return false;
+	}
+
+	vRow.resize(iWidth * 3);
+	return true;
+}
+
+bool PpmReader::readToken(QByteArray &token)
+{
+	token.clear();
+
+	char c;
+	while (mFile.getChar(&c))
+	{
+		if (c == '#')
+		{
+			// comment up to the end of the line
+			while (mFile.getChar(&c) && c != '\n')
+				;
+			continue;
+		}
+
+		if (isspace(uchar(c)))
+		{
+			if (token.isEmpty())
+				continue;
+
+			mFile.ungetChar(c);
+			return true;
+		}
+
+		token.append(c);
+	}
+
+	return !token.isEmpty();
+}
+
+bool PpmReader::readRow(QRgb *row)
+{
+	auto size = qint64(vRow.size());
+	if (mFile.read(reinterpret_cast<char *>(vRow.data()), size) != size)
+	{
+		sError = QString("%1 is truncated").arg(mFile.fileName());
+		return false;
+	}
+
+	auto in = vRow.constData();
+	for (int x = 0; x < iWidth; x++, in += 3)
+		row[x] = qRgb(in[0], in[1], in[2]);
+
+	return true;
+}
+
+PpmWriter::PpmWriter()
+	: mFile()
+	, vRow()
+	, sError()
+	, iWidth(0)
+{
+}
+
+bool PpmWriter::open(const QString &fileName, int width, int height)
+{
+	mFile.setFileName(fileName);
+	if (!mFile.open(QIODevice::WriteOnly))
+	{
+		sError = QString("Could not write %1").arg(fileName);
+		return false;
+	}
+
+	iWidth = width;
+	vRow.resize(width * 3);
+
+	auto header = QString("P6\n%1 %2\n255\n").arg(width).arg(height).toLatin1();
+	return mFile.write(header) == header.size();
+}
+
+bool PpmWriter::writeRow(const QRgb *row)
+{
+	auto out = vRow.data();
+	for (int x = 0; x < iWidth; x++, out += 3)
+	{
+		out[0] = uchar(qRed(row[x]));
+		out[1] = uchar(qGreen(row[x]));
+		out[2] = uchar(qBlue(row[x]));
+	}
+
+	auto size = qint64(vRow.size());
+	if (mFile.write(reinterpret_cast<const char *>(vRow.constData()), size) != size)
+	{
+		sError = QString("Could not write %1").arg(mFile.fileName());
+		return false;
+	}
+
+	return true;
+}
+
+bool PpmWriter::close()
+{
+	if (!mFile.flush())
+	{
+		sError = QString("Could not write %1").arg(mFile.fileName());
+		return false;
+	}
+
+	mFile.close();
+	return true;
+}
@@ -0,0 +1,72 @@
+#ifndef PPMFILE_H
+#define PPMFILE_H
+
+#include <QFile>
+#include <QVector>
+#include <QString>
+#include <QRgb>
+
+// Binary PPM (P6, 8 bit) read and written one row at a time, for images that
+// do not fit in memory, or in a QImage, at once. Colors are QRgb, opaque.
+class PpmReader
+{
+	public:
+		PpmReader();
+
+		bool open(const QString &fileName);
+
+		int width() const
+		{
+			return iWidth;
+		}
+
+		int height() const
+		{
+			return iHeight;
+		}
+
+		qint64 count() const
+		{
+			return qint64(iWidth) * iHeight;
+		}
+
+		// Reads the next width() pixels into row.
+		bool readRow(QRgb *row);
+
+		QString errorString() const
+		{
+			return sError;
+		}
+
+	private:
+		bool readToken(QByteArray &token);
+
+		QFile mFile;
+		QVector<uchar> vRow;
+		QString sError;
+		int iWidth;
+		int iHeight;
+};
+
+class PpmWriter
+{
+	public:
+		PpmWriter();
+
+		bool open(const QString &fileName, int width, int height);
+		bool writeRow(const QRgb *row);
+		bool close();
+
+		QString errorString() const
+		{
+			return sError;
+		}
+
+	private:
+		QFile mFile;
+		QVector<uchar> vRow;
+		QString sError;
+		int iWidth;
+};
+
+#endif // PPMFILE_H
@@ -0,0 +1,98 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+// Unsigned encoding of a float that keeps its order: a < b exactly when
+// radixKey(a) < radixKey(b). NaN has no order and must be replaced first.
+inline quint32 radixKey(float f)
+{
+	quint32 u;
+	std::memcpy(&u, &f, sizeof(u));
+	return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+// Stable sort of n records by key(record) ascending, an unsigned 32 bit value
+// like radixKey() gives. Four LSD passes of 8 bits, each over the thread pool:
+// every thread counts the digits of its own block, the counts of all blocks
+// add up to where each block writes every digit, then every thread scatters
+// its block. A pass where all records share the digit is skipped. tmp is
+// scratch space for n records.
+template <class T, class Key>
+void radixSort(T *data, T *tmp, int n, Key key)
+{
+	static const int kDigits = 256;
+	static const int kMinBlock = 1 << 16;
+
+	auto blocks = qBound(1, n / kMinBlock, QThread::idealThreadCount());
+	QVector<int> ids(blocks);
+	for (int b = 0; b < blocks; b++)
+		ids[b] = b;
+
+	auto blockStart = [n, blocks](int b)
+	{
+		return int(qint64(n) * b / blocks);
+	};
+
+	// digit counts of each block, then the offsets they write to
+	QVector<int> offsets(blocks * kDigits);
+	auto src = data;
+	auto dst = tmp;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		offsets.fill(0);
+		auto counts = offsets.data();
+
+		QtConcurrent::blockingMap(ids, [&](int &b)
+		{
+			auto count = counts + b * kDigits;
+			for (int i = blockStart(b), end = blockStart(b + 1); i < end; i++)
+				count[(key(src[i]) >> shift) & 0xff]++;
+		});
+
+		// digit d of block b follows all smaller digits and digit d of the
+		// blocks before it, which keeps the sort stable
+		auto trivial = false;
+		auto total = 0;
+		for (int d = 0; d < kDigits; d++)
+		{
+			auto digitStart = total;
+			for (int b = 0; b < blocks; b++)
+			{
+				auto &count = counts[b * kDigits + d];
+				auto start = total;
+				total += count;
+				count = start;
+			}
+
+			// the digit of every record, over all blocks
+			trivial = trivial || total - digitStart == n;
+		}
+
+		if (trivial)
+			continue;
+
+		QtConcurrent::blockingMap(ids, [&](int &b)
+		{
+			auto next = counts + b * kDigits;
+			for (int i = blockStart(b), end = blockStart(b + 1); i < end; i++)
+			{
+				const auto &r = src[i];
+				dst[next[(key(r) >> shift) & 0xff]++] = r;
+			}
+		});
+
+		std::swap(src, dst);
+	}
+
+	if (src != data)
+		std::copy(src, src + n, data);
+}
+
+#endif // RADIXSORT_H
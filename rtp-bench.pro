@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Distance kernel microbenchmarks.
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = RTM-bench
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(core.pri)
+
+SOURCES += benchdistance.cpp
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Headless runner: no widgets, no display needed.
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = RTM-cli
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(core.pri)
+
+SOURCES += cli.cpp
+
+OTHER_FILES += \
+    README.md
@@ -12,21 +12,16 @@ TARGET = RTM
 TEMPLATE = app
 CONFIG += c++11
 
+include(core.pri)
+
 SOURCES += main.cpp\
 		mainwindow.cpp \
 	imageselectlabel.cpp \
-	ialgorithm.cpp \
-	algorithmcopy.cpp \
-	algorithmsort.cpp \
-	algorithmswap.cpp
+	imagepreview.cpp
 
 HEADERS  += mainwindow.h \
 	imageselectlabel.h \
-	ialgorithm.h \
-	algorithmcopy.h \
-	pixel.h \
-	algorithmsort.h \
-	algorithmswap.h
+	imagepreview.h
 
 FORMS    += mainwindow.ui
 
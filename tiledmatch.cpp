@@ -0,0 +1,424 @@
+#include "tiledmatch.h"
+#include "ppmfile.h"
+#include "trace.h"
+#include <QDir>
+#include <QTemporaryFile>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+struct TiledMatch::KeyRecord
+{
+	double fD;
+	qint64 iIndex;
+	QRgb c;
+
+	// index second, so equal keys keep the row major order
+	bool operator<(const KeyRecord &other) const
+	{
+		return fD < other.fD || (fD == other.fD && iIndex < other.iIndex);
+	}
+};
+
+// A result pixel inside its band of rows.
+struct TiledMatch::Placement
+{
+	quint32 iOffset;
+	QRgb c;
+};
+
+// Fixed size records in a temporary file, written and then read back in
+// order through a buffer of its own.
+template <class T>
+class TiledMatch::RecordFile
+{
+	public:
+		RecordFile(const QString &path, qint64 bufferBytes)
+			: mFile(path + "/rtm-XXXXXX.tmp")
+			, vBuffer(int(qMax<qint64>(1, bufferBytes / qint64(sizeof(T)))))
+			, iPos(0)
+			, iSize(0)
+			, iCount(0)
+		{
+		}
+
+		bool open()
+		{
+			return mFile.open();
+		}
+
+		void setBufferBytes(qint64 bytes)
+		{
+			vBuffer.resize(int(qMax<qint64>(1, bytes / qint64(sizeof(T)))));
+			iPos = iSize = 0;
+		}
+
+		bool write(const T &record)
+		{
+			vBuffer[iPos++] = record;
+			iCount++;
+
+			return iPos < vBuffer.size() || flush();
+		}
+
+		bool write(const T *records, qint64 n)
+		{
+			iCount += n;
+
+			auto bytes = n * qint64(sizeof(T));
+			return mFile.write(reinterpret_cast<const char *>(records), bytes) == bytes;
+		}
+
+		bool flush()
+		{
+			auto bytes = iPos * qint64(sizeof(T));
+			iPos = 0;
+
+			return mFile.write(reinterpret_cast<const char *>(vBuffer.constData()), bytes) == bytes;
+		}
+
+		// Switches from writing to reading from the first record, call flush()
+		// first after single record writes.
+		bool rewind()
+		{
+			iPos = iSize = 0;
+			return mFile.flush() && mFile.seek(0);
+		}
+
+		// False at the end, or on a read error.
+		bool read(T &record)
+		{
+			if (iPos == iSize)
+			{
+				auto bytes = mFile.read(reinterpret_cast<char *>(vBuffer.data()), vBuffer.size() * qint64(sizeof(T)));
+				iSize = bytes > 0 ? int(bytes / qint64(sizeof(T))) : 0;
+				iPos = 0;
+
+				if (iSize == 0)
+					return false;
+			}
+
+			record = vBuffer[iPos++];
+			return true;
+		}
+
+		qint64 count() const
+		{
+			return iCount;
+		}
+
+		qint64 bufferBytes() const
+		{
+			return vBuffer.size() * qint64(sizeof(T));
+		}
+
+	private:
+		QTemporaryFile mFile;
+		QVector<T> vBuffer;
+		int iPos;
+		int iSize;
+		qint64 iCount;
+};
+
+// Records of sorted runs in ascending order, through a heap of their heads.
+class TiledMatch::Merger
+{
+	public:
+		explicit Merger(const QList<RecordFile<KeyRecord> *> &runs)
+			: vRuns(runs)
+			, vHeap()
+		{
+		}
+
+		bool start()
+		{
+			for (int i = 0; i < vRuns.size(); i++)
+			{
+				if (!vRuns[i]->rewind())
+					return false;
+
+				Head head;
+				head.iRun = i;
+				if (vRuns[i]->read(head.mRecord))
+					vHeap.append(head);
+			}
+
+			std::make_heap(vHeap.begin(), vHeap.end());
+			return true;
+		}
+
+		bool next(KeyRecord &record)
+		{
+			if (vHeap.isEmpty())
+				return false;
+
+			std::pop_heap(vHeap.begin(), vHeap.end());
+			auto &head = vHeap.last();
+			record = head.mRecord;
+
+			if (vRuns[head.iRun]->read(head.mRecord))
+				std::push_heap(vHeap.begin(), vHeap.end());
+			else
+				vHeap.removeLast();
+
+			return true;
+		}
+
+	private:
+		struct Head
+		{
+			KeyRecord mRecord;
+			int iRun;
+
+			// std heaps keep the largest on top
+			bool operator<(const Head &other) const
+			{
+				return other.mRecord < mRecord;
+			}
+		};
+
+		QList<RecordFile<KeyRecord> *> vRuns;
+		QVector<Head> vHeap;
+};
+
+TiledMatch::TiledMatch()
+	: mCounters()
+	, sTempPath(QDir::tempPath())
+	, sError()
+	, iMemoryLimit(qint64(1) << 30)
+	, iCount(0)
+	, fError(0)
+{
+}
+
+void TiledMatch::setMemoryLimit(qint64 bytes)
+{
+	iMemoryLimit = qMax<qint64>(bytes, 16 * kMinBufferBytes);
+}
+
+void TiledMatch::setTempPath(const QString &path)
+{
+	sTempPath = path;
+}
+
+bool TiledMatch::fail(const QString &error)
+{
+	sError = error;
+	return false;
+}
+
+bool TiledMatch::run(const QString &input, const QString &palette, const QString &output, ColorKeysFunction keys, ErrorTracker::Distance distance)
+{
+	mCounters.reset();
+	iCount = 0;
+	fError = 0;
+
+	PpmReader inputReader;
+	PpmReader paletteReader;
+	if (!inputReader.open(input))
+		return fail(inputReader.errorString());
+
+	if (!paletteReader.open(palette))
+		return fail(paletteReader.errorString());
+
+	if (inputReader.count() != paletteReader.count())
+		return fail("Input and palette must have the same pixel count.");
+
+	auto width = inputReader.width();
+	auto height = inputReader.height();
+	iCount = inputReader.count();
+
+	QList<RecordFile<KeyRecord> *> inputRuns;
+	QList<RecordFile<KeyRecord> *> paletteRuns;
+	QList<RecordFile<Placement> *> bands;
+	auto cleanup = [&]()
+	{
+		qDeleteAll(inputRuns);
+		qDeleteAll(paletteRuns);
+		qDeleteAll(bands);
+	};
+
+	if (!sortRuns(inputReader, keys, inputRuns) || !sortRuns(paletteReader, keys, paletteRuns))
+	{
+		cleanup();
+		return false;
+	}
+
+	// result bands take half the memory when filled, offsets fit 32 bits
+	auto bandRows = qBound<qint64>(1, iMemoryLimit / 2 / (qint64(width) * sizeof(QRgb)), std::numeric_limits<qint32>::max() / width);
+	auto bandCount = int((height + bandRows - 1) / bandRows);
+	auto bandPixels = bandRows * width;
+
+	{
+		TraceScope trace("merge");
+		CounterScope scope(mCounters, Counters::kPhaseMatch);
+
+		// every open run and band gets an even share of the memory
+		auto files = inputRuns.size() + paletteRuns.size() + bandCount;
+		auto bufferBytes = qMax<qint64>(kMinBufferBytes, iMemoryLimit / files);
+		Counters::count(Counters::kCounterBytesAllocated, files * bufferBytes);
+
+		for (auto run : inputRuns + paletteRuns)
+			run->setBufferBytes(bufferBytes);
+
+		for (int b = 0; b < bandCount; b++)
+		{
+			bands.append(new RecordFile<Placement>(sTempPath, bufferBytes));
+			if (!bands.last()->open())
+			{
+				cleanup();
+				return fail(QString("Could not create a temporary file in %1").arg(sTempPath));
+			}
+		}
+
+		Merger inputs(inputRuns);
+		Merger palettes(paletteRuns);
+		if (!inputs.start() || !palettes.start())
+		{
+			cleanup();
+			return fail("Could not read back the sorted runs.");
+		}
+
+		KeyRecord in;
+		KeyRecord pal;
+		qint64 matched = 0;
+		while (inputs.next(in) && palettes.next(pal))
+		{
+			Placement p;
+			p.iOffset = quint32(in.iIndex % bandPixels);
+			p.c = pal.c;
+
+			if (!bands[int(in.iIndex / bandPixels)]->write(p))
+			{
+				cleanup();
+				return fail(QString("Could not write a temporary file in %1").arg(sTempPath));
+			}
+
+			// undefined distances count as a match, like in ErrorTracker
+			auto d = distance(Pixel(in.c), Pixel(pal.c));
+			if (d > 0)
+				fError += d;
+
+			matched++;
+		}
+
+		Counters::count(Counters::kCounterDistances, matched);
+
+		if (matched != iCount)
+		{
+			cleanup();
+			return fail("Could not read back the sorted runs.");
+		}
+
+		// the runs are not needed anymore, free their disk space
+		qDeleteAll(inputRuns);
+		qDeleteAll(paletteRuns);
+		inputRuns.clear();
+		paletteRuns.clear();
+	}
+
+	TraceScope trace("writeBands");
+	CounterScope scope(mCounters, Counters::kPhaseWrite);
+
+	PpmWriter writer;
+	if (!writer.open(output, width, height))
+	{
+		cleanup();
+		return fail(writer.errorString());
+	}
+
+	auto size = int(bandPixels);
+	QVector<QRgb> pixels(size);
+	Counters::count(Counters::kCounterBytesAllocated, bandPixels * qint64(sizeof(QRgb)));
+
+	for (int b = 0; b < bandCount; b++)
+	{
+		auto band = bands[b];
+		if (!band->flush() || !band->rewind())
+		{
+			cleanup();
+			return fail("Could not read back a result band.");
+		}
+
+		Placement p;
+		while (band->read(p))
+			pixels[int(p.iOffset)] = p.c;
+
+		auto rows = int(qMin<qint64>(bandRows, height - b * bandRows));
+		for (int y = 0; y < rows; y++)
+		{
+			if (!writer.writeRow(pixels.constData() + qint64(y) * width))
+			{
+				cleanup();
+				return fail(writer.errorString());
+			}
+		}
+
+		delete band;
+		bands[b] = nullptr;
+	}
+
+	cleanup();
+
+	if (!writer.close())
+		return fail(writer.errorString());
+
+	return true;
+}
+
+bool TiledMatch::sortRuns(PpmReader &reader, ColorKeysFunction keys, QList<RecordFile<KeyRecord> *> &runs)
+{
+	TraceScope trace("sortRuns");
+	CounterScope scope(mCounters, Counters::kPhaseSort);
+
+	auto width = reader.width();
+	auto limit = iMemoryLimit / qint64(sizeof(KeyRecord));
+	auto capacity = int(qBound<qint64>(width, limit, std::numeric_limits<int>::max() / 2));
+
+	QVector<KeyRecord> records;
+	records.reserve(int(qMin<qint64>(capacity, reader.count())));
+	Counters::count(Counters::kCounterBytesAllocated, records.capacity() * qint64(sizeof(KeyRecord)));
+
+	QVector<QRgb> row(width);
+	QVector<Pixel> colors(width);
+	QVector<double> rowKeys(width);
+
+	auto flushRun = [&]()
+	{
+		std::sort(records.begin(), records.end());
+
+		auto run = new RecordFile<KeyRecord>(sTempPath, 0);
+		runs.append(run);
+
+		auto ok = run->open() && run->write(records.constData(), records.size());
+		records.clear();
+
+		return ok || fail(QString("Could not write a temporary file in %1").arg(sTempPath));
+	};
+
+	for (int y = 0; y < reader.height(); y++)
+	{
+		if (!reader.readRow(row.data()))
+			return fail(reader.errorString());
+
+		for (int x = 0; x < width; x++)
+			colors[x] = Pixel(row[x]);
+
+		keys(colors, rowKeys.data());
+
+		if (records.size() + width > capacity && !flushRun())
+			return false;
+
+		for (int x = 0; x < width; x++)
+		{
+			KeyRecord r;
+			r.fD = rowKeys[x];
+			r.iIndex = qint64(y) * width + x;
+			r.c = row[x];
+			records.append(r);
+		}
+	}
+
+	return records.isEmpty() || flushRun();
+}
@@ -0,0 +1,73 @@
+#ifndef TILEDMATCH_H
+#define TILEDMATCH_H
+
+#include "metric.h"
+#include "errortracker.h"
+#include "counters.h"
+#include <QString>
+
+class PpmReader;
+
+// Indexed Replace for images that fit neither in memory nor in a QImage: the
+// input pixel with the n-th smallest key gets the color of the palette pixel
+// with the n-th smallest key.
+//
+// Both images are streamed from binary PPM files a row at a time. Their keys
+// are sorted in runs that fit the memory limit, the runs merged from disk,
+// and every match is sent to the band of result rows it belongs to, which are
+// then filled and written one at a time. Pixel indices are 64 bit, the disk
+// holds about 56 bytes of temporary files per pixel.
+class TiledMatch
+{
+	public:
+		TiledMatch();
+
+		// Bytes of buffers held at once, roughly. 1 GiB by default.
+		void setMemoryLimit(qint64 bytes);
+
+		// Directory of the temporary files, the system one by default.
+		void setTempPath(const QString &path);
+
+		bool run(const QString &input, const QString &palette, const QString &output, ColorKeysFunction keys, ErrorTracker::Distance distance);
+
+		qint64 count() const
+		{
+			return iCount;
+		}
+
+		// Total distance of the result to the input.
+		double error() const
+		{
+			return fError;
+		}
+
+		Counters &counters()
+		{
+			return mCounters;
+		}
+
+		QString errorString() const
+		{
+			return sError;
+		}
+
+		static const int kMinBufferBytes = 64 * 1024;
+
+	private:
+		struct KeyRecord;
+		struct Placement;
+		template <class T> class RecordFile;
+		class Merger;
+
+		bool sortRuns(PpmReader &reader, ColorKeysFunction keys, QList<RecordFile<KeyRecord> *> &runs);
+		bool fail(const QString &error);
+
+		Counters mCounters;
+		QString sTempPath;
+		QString sError;
+		qint64 iMemoryLimit;
+		qint64 iCount;
+		double fError;
+};
+
+#endif // TILEDMATCH_H
@@ -0,0 +1,138 @@
+#include "trace.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+namespace
+{
+	struct Event
+	{
+		const char *pName;
+		const char *pCategory;
+		const char *pArgName;
+		qint64 iArgValue;
+		qint64 iBegin;
+		qint64 iDuration;
+		int iThread;
+	};
+
+	QAtomicInt sEnabled;
+	QAtomicInt sThreads;
+	int sMainThread = 0;
+	QElapsedTimer sClock;
+	QMutex sLock;
+	QVector<Event> sEvents;
+
+	// Small stable ids read better in the viewer than native thread handles.
+	thread_local int tThread = -1;
+
+	int threadId()
+	{
+		if (tThread < 0)
+			tThread = sThreads.fetchAndAddRelaxed(1);
+
+		return tThread;
+	}
+}
+
+void Trace::start()
+{
+	QMutexLocker lock(&sLock);
+	sEvents.clear();
+	sClock.start();
+
+	// the thread that starts recording is shown as the main one
+	sMainThread = threadId();
+
+	sEnabled.storeRelease(1);
+}
+
+void Trace::stop()
+{
+	sEnabled.storeRelease(0);
+}
+
+bool Trace::isEnabled()
+{
+	return sEnabled.loadAcquire() != 0;
+}
+
+qint64 Trace::now()
+{
+	return sClock.nsecsElapsed();
+}
+
+void Trace::add(const char *name, const char *category, qint64 begin, qint64 duration, const char *argName, qint64 argValue)
+{
+	Event e = { name, category, argName, argValue, begin, duration, threadId() };
+
+	QMutexLocker lock(&sLock);
+	sEvents.append(e);
+}
+
+bool Trace::save(const QString &fileName)
+{
+	QVector<Event> events;
+	int mainThread;
+	{
+		QMutexLocker lock(&sLock);
+		events = sEvents;
+		mainThread = sMainThread;
+	}
+
+	QJsonArray list;
+	QVector<bool> named(sThreads.load());
+	for (auto &e : events)
+	{
+		if (!named[e.iThread])
+		{
+			named[e.iThread] = true;
+
+			QJsonObject args;
+			args.insert("name", e.iThread == mainThread ? QString("main") : QString("worker %1").arg(e.iThread));
+
+			QJsonObject meta;
+			meta.insert("name", "thread_name");
+			meta.insert("ph", "M");
+			meta.insert("pid", 1);
+			meta.insert("tid", e.iThread);
+			meta.insert("args", args);
+			list.append(meta);
+		}
+
+		// complete events, in microseconds
+		QJsonObject event;
+		event.insert("name", e.pName);
+		event.insert("cat", e.pCategory);
+		event.insert("ph", "X");
+		event.insert("ts", e.iBegin / 1000.0);
+		event.insert("dur", e.iDuration / 1000.0);
+		event.insert("pid", 1);
+		event.insert("tid", e.iThread);
+
+		if (e.pArgName)
+		{
+			QJsonObject args;
+			args.insert(e.pArgName, double(e.iArgValue));
+			event.insert("args", args);
+		}
+
+		list.append(event);
+	}
+
+	QJsonObject json;
+	json.insert("traceEvents", list);
+	json.insert("displayTimeUnit", "ms");
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	return file.write(QJsonDocument(json).toJson(QJsonDocument::Compact)) >= 0;
+}
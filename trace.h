@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtGlobal>
+#include <QString>
+
+// Timeline of scoped events in the Chrome trace event format, which opens in
+// Perfetto (ui.perfetto.dev) and chrome://tracing.
+//
+// Recording is off until start() and a TraceScope costs a single check while
+// it is. Events are kept in memory and written at once by save(), so only
+// coarse scopes belong here: setup steps, worker tasks, update slices.
+class Trace
+{
+	public:
+		static void start();
+		static void stop();
+
+		static bool isEnabled();
+
+		// Writes every event recorded since start(), returns false on error.
+		static bool save(const QString &fileName);
+
+		// Records an event of the calling thread, times in nanoseconds since start().
+		static void add(const char *name, const char *category, qint64 begin, qint64 duration, const char *argName, qint64 argValue);
+
+		static qint64 now();
+};
+
+// Records the time from its construction to its destruction as one event.
+// Names and categories must be string literals, they are kept as pointers.
+class TraceScope
+{
+	public:
+		explicit TraceScope(const char *name, const char *category = "rtm")
+			: pName(name)
+			, pCategory(category)
+			, pArgName(nullptr)
+			, iArgValue(0)
+			, iBegin(Trace::isEnabled() ? Trace::now() : -1)
+		{
+		}
+
+		~TraceScope()
+		{
+			if (iBegin >= 0)
+				Trace::add(pName, pCategory, iBegin, Trace::now() - iBegin, pArgName, iArgValue);
+		}
+
+		// One value shown with the event, like the size of a work item.
+		void setArg(const char *name, qint64 value)
+		{
+			pArgName = name;
+			iArgValue = value;
+		}
+
+	private:
+		const char *pName;
+		const char *pCategory;
+		const char *pArgName;
+		qint64 iArgValue;
+		qint64 iBegin;
+};
+
+#endif // TRACE_H